@@ -20,6 +20,7 @@
 #include <stb_image_resize.h>
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
+#include <dsp/scheduler.h>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -126,7 +127,10 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["fftHeight"] = 300;
     defConfig["fftRate"] = 20;
     defConfig["fftSize"] = 65536;
+    defConfig["fftThreads"] = 0;
     defConfig["fftWindow"] = 2;
+    defConfig["fftAveraging"] = false;
+    defConfig["fftOverlap"] = 50;
     defConfig["fftZoom"] = 1.0f;
     defConfig["mpxLineWidth"] = displaymenu::MPX_DEFAULT_LINE_WIDTH;
     defConfig["mpxRefreshRate"] = displaymenu::MPX_DEFAULT_REFRESH_RATE;
@@ -256,8 +260,12 @@ int sdrpp_main(int argc, char* argv[]) {
     defConfig["showWaterfall"] = true;
     defConfig["source"] = "";
     defConfig["decimation"] = 1;
+    defConfig["dspScheduler"] = "thread";
+    defConfig["dspSchedulerThreads"] = 0;
     defConfig["iqCorrection"] = false;
     defConfig["invertIQ"] = false;
+    defConfig["vfoChannelizer"] = false;
+    defConfig["vfoChannelizerChannels"] = 64;
 
     defConfig["streams"]["Radio"]["muted"] = false;
     defConfig["streams"]["Radio"]["sink"] = "Audio";
@@ -364,6 +372,14 @@ int sdrpp_main(int argc, char* argv[]) {
     // Load UI scaling
     style::uiScale = core::configManager.conf["uiScale"];
 
+    // Select the DSP scheduler, must be done before any block is started
+    std::string dspScheduler = core::configManager.conf["dspScheduler"];
+    int dspSchedulerThreads = core::configManager.conf["dspSchedulerThreads"];
+    if (dspScheduler == "pool") {
+        dsp::getScheduler().start(dspSchedulerThreads);
+        flog::info("Using pool DSP scheduler with {0} threads", dsp::getScheduler().getThreadCount());
+    }
+
     core::configManager.release(true);
 
     if (serverMode) { return server::main(); }
@@ -422,6 +438,8 @@ int sdrpp_main(int argc, char* argv[]) {
 
     sigpath::iqFrontEnd.stop();
 
+    dsp::getScheduler().stop();
+
     core::configManager.disableAutoSave();
     core::configManager.save();
 #endif
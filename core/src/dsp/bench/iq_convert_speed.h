@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <stdlib.h>
+#include "../buffer/buffer.h"
+#include "../convert/iq_convert.h"
+
+namespace dsp::bench {
+    // Scalar loop that the RTL-SDR source used before convert::u8ToComplex(), kept as reference
+    inline void u8ToComplexReference(complex_t* out, const uint8_t* in, int count) {
+        for (int i = 0; i < count; i++) {
+            out[i].re = ((float)in[i * 2] - 127.4) / 128.0f;
+            out[i].im = ((float)in[(i * 2) + 1] - 127.4) / 128.0f;
+        }
+    }
+
+    // Measure the throughput of an IQ conversion function in complex samples per second. The function is called
+    // as convert(out, in, count) on random bytes, 'bytesPerSample' being the size of one complex sample in the input.
+    template <class Func>
+    inline double iqConvertSpeed(Func convert, int bytesPerSample, int durationMs) {
+        const int count = 65536;
+        uint8_t* in = buffer::alloc<uint8_t>(count * bytesPerSample);
+        complex_t* out = buffer::alloc<complex_t>(count);
+        for (int i = 0; i < count * bytesPerSample; i++) {
+            in[i] = rand();
+        }
+
+        uint64_t samples = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start + std::chrono::milliseconds(durationMs);
+        auto now = start;
+        while (now < end) {
+            convert(out, in, count);
+            samples += count;
+            now = std::chrono::high_resolution_clock::now();
+        }
+        double elapsed = std::chrono::duration<double>(now - start).count();
+
+        buffer::free(in);
+        buffer::free(out);
+        return (double)samples / elapsed;
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include <stdlib.h>
+#include "../buffer/buffer.h"
+#include "../math/spectrum_reduce.h"
+
+namespace dsp::bench {
+    // Measure the throughput of math::maxPool() in input bins per second, reducing a random spectrum of inSize bins to outSize bins
+    inline double maxPoolSpeed(int inSize, int outSize, int durationMs) {
+        float* in = buffer::alloc<float>(inSize);
+        float* out = buffer::alloc<float>(outSize);
+        for (int i = 0; i < inSize; i++) {
+            in[i] = -100.0f * (float)rand() / (float)RAND_MAX;
+        }
+
+        uint64_t bins = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start + std::chrono::milliseconds(durationMs);
+        auto now = start;
+        while (now < end) {
+            math::maxPool(in, inSize, 0, inSize, out, outSize);
+            bins += inSize;
+            now = std::chrono::high_resolution_clock::now();
+        }
+        double elapsed = std::chrono::duration<double>(now - start).count();
+
+        buffer::free(in);
+        buffer::free(out);
+        return (double)bins / elapsed;
+    }
+}
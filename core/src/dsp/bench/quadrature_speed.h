@@ -0,0 +1,100 @@
+#pragma once
+#include <chrono>
+#include <stdlib.h>
+#include "../buffer/buffer.h"
+#include "../demod/quadrature.h"
+
+namespace dsp::bench {
+    // Scalar FM demodulation loop that demod::Quadrature used before it was vectorized, kept as reference
+    inline void quadratureReference(int count, complex_t* in, float* out, float& phase, float invDeviation) {
+        for (int i = 0; i < count; i++) {
+            float cphase = in[i].phase();
+            out[i] = math::normalizePhase(cphase - phase) * invDeviation;
+            phase = cphase;
+        }
+    }
+
+    inline complex_t* quadratureTestSignal(int count) {
+        // FM signal with a random walk phase and varying amplitude
+        complex_t* sig = buffer::alloc<complex_t>(count);
+        float phase = 0.0f;
+        for (int i = 0; i < count; i++) {
+            phase = math::normalizePhase(phase + 3.0f * ((float)rand() / (float)RAND_MAX - 0.5f));
+            float amp = 0.01f + (float)rand() / (float)RAND_MAX;
+            sig[i] = { amp * cosf(phase), amp * sinf(phase) };
+        }
+        return sig;
+    }
+
+    // Measure the throughput of the reference loop in samples per second
+    inline double quadratureReferenceSpeed(int durationMs) {
+        const int count = 65536;
+        complex_t* in = quadratureTestSignal(count);
+        float* out = buffer::alloc<float>(count);
+        float phase = 0.0f;
+
+        uint64_t samples = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start + std::chrono::milliseconds(durationMs);
+        auto now = start;
+        while (now < end) {
+            quadratureReference(count, in, out, phase, 1.0f);
+            samples += count;
+            now = std::chrono::high_resolution_clock::now();
+        }
+        double elapsed = std::chrono::duration<double>(now - start).count();
+
+        buffer::free(in);
+        buffer::free(out);
+        return (double)samples / elapsed;
+    }
+
+    // Measure the throughput of demod::Quadrature in samples per second
+    inline double quadratureSpeed(math::Atan2Accuracy accuracy, int durationMs) {
+        const int count = 65536;
+        complex_t* in = quadratureTestSignal(count);
+        float* out = buffer::alloc<float>(count);
+        demod::Quadrature demod(NULL, 1.0);
+        demod.out.free();
+        demod.setAccuracy(accuracy);
+
+        uint64_t samples = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto end = start + std::chrono::milliseconds(durationMs);
+        auto now = start;
+        while (now < end) {
+            demod.process(count, in, out);
+            samples += count;
+            now = std::chrono::high_resolution_clock::now();
+        }
+        double elapsed = std::chrono::duration<double>(now - start).count();
+
+        buffer::free(in);
+        buffer::free(out);
+        return (double)samples / elapsed;
+    }
+
+    // Largest difference in radians between demod::Quadrature and the reference loop
+    inline double quadratureMaxError(math::Atan2Accuracy accuracy) {
+        const int count = 65536;
+        complex_t* in = quadratureTestSignal(count);
+        float* ref = buffer::alloc<float>(count);
+        float* out = buffer::alloc<float>(count);
+        float phase = 0.0f;
+        demod::Quadrature demod(NULL, 1.0);
+        demod.out.free();
+        demod.setAccuracy(accuracy);
+
+        quadratureReference(count, in, ref, phase, 1.0f);
+        demod.process(count, in, out);
+        double maxErr = 0.0;
+        for (int i = 0; i < count; i++) {
+            maxErr = std::max<double>(maxErr, fabs(math::normalizePhase(out[i] - ref[i])));
+        }
+
+        buffer::free(in);
+        buffer::free(ref);
+        buffer::free(out);
+        return maxErr;
+    }
+}
@@ -1,10 +1,14 @@
 #pragma once
 #include <thread>
+#include <chrono>
+#include <stdlib.h>
 #include <assert.h>
 #include "../stream.h"
 #include "../types.h"
 
 namespace dsp::bench {
+    // Measures the throughput of a block in input samples per second by feeding random chunks into its input
+    // stream from one thread while another one consumes its output
     template<class I,  class O>
     class SpeedTester {
     public:
@@ -47,12 +51,14 @@ namespace dsp::bench {
                 }
             }
 
-            // Run test
+            // Run test, timing the actual run instead of trusting the sleep
+            auto begin = std::chrono::steady_clock::now();
             start();
             std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
             stop();
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
             buffer::free(randBuf);
-            return (double)sampCount * 1000.0 / (double)durationMs;
+            return (double)sampCount / elapsed;
         }
 
     protected:
@@ -76,8 +82,13 @@ namespace dsp::bench {
         }
 
         void writeWorker() {
+            // Blocks don't modify their input, so once both stream buffers hold the data it doesn't need copying again
+            int copies = 0;
             while (true) {
-                memcpy(_in->writeBuf, randBuf, inCount * sizeof(I));
+                if (copies < 2) {
+                    memcpy(_in->writeBuf, randBuf, inCount * sizeof(I));
+                    copies++;
+                }
                 if (!_in->swap(inCount)) { return; }
                 sampCount += inCount;
             }
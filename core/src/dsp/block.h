@@ -3,9 +3,19 @@
 #include <thread>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
 #include "stream.h"
+#include "scheduler.h"
 #include "types.h"
 
+// Time given to a running block to apply a synchronous update before it's stopped to apply it
+#define BLOCK_SYNC_UPDATE_TIMEOUT_MS    100
+
 namespace dsp {
     class generic_block {
     public:
@@ -41,6 +51,7 @@ namespace dsp {
             }
             doStop();
             running = false;
+            applyUpdates();
         }
 
         void tempStart() {
@@ -58,17 +69,126 @@ namespace dsp {
             if (running && !tempStopped) {
                 doStop();
                 tempStopped = true;
+                applyUpdates();
             }
         }
 
+        // Apply a configuration change without stopping the worker. While the block is running, the change is
+        // queued and applied by the worker before its next call to run(), otherwise it's applied right away.
+        // Anything the change replaces can only be freed once it's applied, typically by the change itself.
+        // Setters built on this return before the change takes effect, and anything slow (allocating filter banks,
+        // planning FFTs) should be prepared by the caller so that the change itself only swaps pointers.
+        void update(std::function<void()> fn) {
+            assert(_block_init);
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            if (!isLive()) {
+                fn();
+                return;
+            }
+            std::lock_guard<std::mutex> lck2(updateMtx);
+            updates.push_back(std::move(fn));
+            updatePending = true;
+        }
+
+        // Same as update() but only returns once the change was applied, for changes the caller depends on (no longer
+        // writing to a stream it's about to hand to another block, ...). If the worker doesn't get to it in time because
+        // it's waiting on its input or outputs, the block is stopped for the time of the change instead.
+        void updateSync(std::function<void()> fn) {
+            assert(_block_init);
+            std::lock_guard<std::recursive_mutex> lck(ctrlMtx);
+            if (!isLive()) {
+                fn();
+                return;
+            }
+
+            struct SyncState {
+                std::mutex mtx;
+                std::condition_variable cv;
+                bool done = false;
+            };
+            auto state = std::make_shared<SyncState>();
+            update([fn, state]() {
+                fn();
+                {
+                    std::lock_guard<std::mutex> lck(state->mtx);
+                    state->done = true;
+                }
+                state->cv.notify_all();
+            });
+
+            bool done;
+            {
+                std::unique_lock<std::mutex> slck(state->mtx);
+                done = state->cv.wait_for(slck, std::chrono::milliseconds(BLOCK_SYNC_UPDATE_TIMEOUT_MS), [&state]() { return state->done; });
+            }
+
+            // Stopping the block applies all pending updates
+            if (!done) {
+                tempStop();
+                tempStart();
+            }
+        }
+
+        // Check if the worker is running, in which case only it may touch the processing state
+        bool isLive() {
+            return running && !tempStopped;
+        }
+
         virtual int run() = 0;
 
+        // Wall time spent in run() and number of calls, only updated when the block is executed by the pool scheduler
+        uint64_t getRunTime() { return runTimeNs; }
+        uint64_t getRunCount() { return runCount; }
+
     protected:
+        friend class Scheduler;
+
         void workerLoop() {
-            while (run() >= 0) {}
+            while (true) {
+                applyUpdates();
+                if (run() < 0) { break; }
+            }
+        }
+
+        // Apply the queued configuration changes, only called by the worker or once it's stopped
+        void applyUpdates() {
+            if (!updatePending.load(std::memory_order_acquire)) { return; }
+            std::vector<std::function<void()>> pending;
+            {
+                std::lock_guard<std::mutex> lck(updateMtx);
+                pending.swap(updates);
+                updatePending = false;
+            }
+            for (auto& fn : pending) { fn(); }
+        }
+
+        // Check if run() can be called without blocking, only valid for schedulable blocks
+        bool isReady() {
+            for (auto& in : inputs) {
+                if (!in->readable()) { return false; }
+            }
+            for (auto& out : outputs) {
+                if (!out->writable()) { return false; }
+            }
+            return true;
+        }
+
+        int timedRun() {
+            applyUpdates();
+            auto start = std::chrono::steady_clock::now();
+            int ret = run();
+            runTimeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            runCount++;
+            return ret;
         }
 
         virtual void doStart() {
+            // Let the pool scheduler run the block if enabled, sources keep their own thread since they may block
+            if (schedulable && getScheduler().isRunning() && !inputs.empty()) {
+                scheduled = true;
+                getScheduler().addBlock(this);
+                return;
+            }
             workerThread = std::thread(&block::workerLoop, this);
         }
 
@@ -80,6 +200,12 @@ namespace dsp {
                 out->stopWriter();
             }
 
+            // Wait for the scheduler to drop the block if it was running on the pool
+            if (scheduled) {
+                getScheduler().removeBlock(this);
+                scheduled = false;
+            }
+
             // TODO: Make sure this isn't needed, I don't know why it stops
             if (workerThread.joinable()) {
                 workerThread.join();
@@ -128,5 +254,18 @@ namespace dsp {
         bool tempStopped = false;
         int tempStopDepth = 0;
         std::thread workerThread;
+
+        std::mutex updateMtx;
+        std::vector<std::function<void()>> updates;
+        std::atomic<bool> updatePending = false;
+
+        // The pool only checks that each input can be read and each output swapped once before calling run().
+        // Blocks that can swap an output several times per call or wait on anything else (readers releasing a
+        // lent buffer, ...) would hold a worker while blocked, they clear this to keep a thread of their own.
+        bool schedulable = true;
+
+        bool scheduled = false;
+        std::atomic<uint64_t> runTimeNs = 0;
+        std::atomic<uint64_t> runCount = 0;
     };
 }
\ No newline at end of file
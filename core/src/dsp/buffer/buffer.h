@@ -1,11 +1,12 @@
 #pragma once
 #include <volk/volk.h>
 #include <string.h>
+#include "pool.h"
 
 namespace dsp::buffer {
     template<class T>
     inline T* alloc(int count) {
-        return (T*)volk_malloc(count * sizeof(T), volk_get_alignment());
+        return (T*)getPool().alloc(count * sizeof(T));
     }
 
     template<class T>
@@ -14,6 +15,6 @@ namespace dsp::buffer {
     }
 
     inline void free(void* buffer) {
-        volk_free(buffer);
+        getPool().free(buffer);
     }
 }
\ No newline at end of file
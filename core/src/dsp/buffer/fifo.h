@@ -0,0 +1,299 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include "buffer.h"
+
+// Number of polling iterations before a waiting side parks on its condition variable
+#define FIFO_SPIN_COUNT 256
+
+// Longest a parked writer can miss a wake from the reader, which never takes the park mutex
+#define FIFO_WRITER_PARK_TIMEOUT_US 1000
+
+namespace dsp::buffer {
+    // Lock-free single-producer/single-consumer sample FIFO with a capacity in samples. The write and read
+    // counters live on separate cache lines, each next to the side's cached copy of the other counter, so a
+    // side only touches the other's line when its copy shows less space or data than it needs. Blocking calls spin for
+    // a little while and then park on a condition variable. Non-blocking calls never wait, samples that
+    // don't fit are dropped and missing samples are replaced by zeros, both being counted. The reader never
+    // locks, so it can be used from an audio callback: it wakes the writer without the park mutex and the
+    // writer parks with a timeout in case the wake lands just before it sleeps.
+    template <class T>
+    class FIFO {
+    public:
+        FIFO() {}
+
+        FIFO(int capacity) { init(capacity); }
+
+        ~FIFO() {
+            if (!_init) { return; }
+            buffer::free(_buffer);
+        }
+
+        void init(int capacity) {
+            assert(capacity > 0);
+            _capacity = capacity;
+            _buffer = buffer::alloc<T>(_capacity);
+            buffer::clear(_buffer, _capacity);
+            _init = true;
+        }
+
+        // Must only be called while neither side is using the FIFO, its content is lost
+        void setCapacity(int capacity) {
+            assert(_init);
+            assert(capacity > 0);
+            buffer::free(_buffer);
+            _capacity = capacity;
+            _buffer = buffer::alloc<T>(_capacity);
+            buffer::clear(_buffer, _capacity);
+            writer.pos = 0;
+            writer.otherPos = 0;
+            reader.pos = 0;
+            reader.otherPos = 0;
+        }
+
+        int getCapacity() {
+            return _capacity;
+        }
+
+        // Write all samples, waiting for space as needed. Returns -1 if the writer was stopped.
+        int write(const T* data, int count) {
+            assert(_init);
+            int written = 0;
+            while (written < count) {
+                int space = waitWritable(count - written);
+                if (space < 0) { return -1; }
+                written += push(&data[written], std::min<int>(space, count - written));
+            }
+            return count;
+        }
+
+        // Write as many samples as fit without waiting, the rest is dropped and counted as overflow
+        int tryWrite(const T* data, int count) {
+            assert(_init);
+            int n = std::min<int>(writable(count), count);
+            if (n) { push(data, n); }
+            if (n < count) { overflows.fetch_add(count - n, std::memory_order_relaxed); }
+            return n;
+        }
+
+        // Read exactly 'count' samples, waiting for them as needed. Returns -1 if the reader was stopped.
+        int read(T* data, int count) {
+            assert(_init);
+            int done = 0;
+            while (done < count) {
+                int avail = waitReadable(count - done);
+                if (avail < 0) { return -1; }
+                done += pop(&data[done], std::min<int>(avail, count - done));
+            }
+            return count;
+        }
+
+        // Read between one and 'maxCount' samples, waiting only if the FIFO is empty. Returns -1 if the reader was stopped.
+        int readSome(T* data, int maxCount) {
+            assert(_init);
+            int avail = waitReadable(maxCount);
+            if (avail < 0) { return -1; }
+            return pop(data, std::min<int>(avail, maxCount));
+        }
+
+        // Read 'count' samples without waiting, missing ones are set to zero and counted as underflow. Returns the number of actual samples.
+        int tryRead(T* data, int count) {
+            assert(_init);
+            handleFlush();
+            int n = std::min<int>(readable(count), count);
+            if (n) { pop(data, n); }
+            if (n < count) {
+                buffer::clear(data, count - n, n);
+                underflows.fetch_add(count - n, std::memory_order_relaxed);
+            }
+            return n;
+        }
+
+        // Discard exactly 'count' samples, waiting for them as needed. Returns -1 if the reader was stopped.
+        int skip(int count) {
+            assert(_init);
+            int done = 0;
+            while (done < count) {
+                int avail = waitReadable(count - done);
+                if (avail < 0) { return -1; }
+                done += pop(NULL, std::min<int>(avail, count - done));
+            }
+            return count;
+        }
+
+        // Can be called from any thread, the content is discarded by the reader before its next read
+        void flush() {
+            flushRequested = true;
+        }
+
+        // Number of samples ready to be read, only exact when called by the reader
+        int available() {
+            return (int)(writer.pos.load() - reader.pos.load());
+        }
+
+        uint64_t getOverflows() { return overflows.load(std::memory_order_relaxed); }
+        uint64_t getUnderflows() { return underflows.load(std::memory_order_relaxed); }
+
+        void resetCounters() {
+            overflows = 0;
+            underflows = 0;
+        }
+
+        void stopWriter() {
+            writerStop = true;
+            {
+                std::lock_guard<std::mutex> lck(parkMtx);
+            }
+            writeCV.notify_all();
+        }
+
+        void clearWriteStop() {
+            writerStop = false;
+        }
+
+        void stopReader() {
+            readerStop = true;
+            {
+                std::lock_guard<std::mutex> lck(parkMtx);
+            }
+            readCV.notify_all();
+        }
+
+        void clearReadStop() {
+            readerStop = false;
+        }
+
+    private:
+        // Free space seen by the writer, the read counter is only loaded if the cached copy shows less than wanted
+        inline int writable(int want) {
+            uint64_t w = writer.pos.load(std::memory_order_relaxed);
+            int space = _capacity - (int)(w - writer.otherPos);
+            if (space >= want) { return space; }
+            writer.otherPos = reader.pos.load();
+            return _capacity - (int)(w - writer.otherPos);
+        }
+
+        // Samples seen by the reader, the write counter is only loaded if the cached copy shows less than wanted
+        inline int readable(int want) {
+            uint64_t r = reader.pos.load(std::memory_order_relaxed);
+            int avail = (int)(reader.otherPos - r);
+            if (avail >= want) { return avail; }
+            reader.otherPos = writer.pos.load();
+            return (int)(reader.otherPos - r);
+        }
+
+        inline int push(const T* data, int count) {
+            uint64_t w = writer.pos.load(std::memory_order_relaxed);
+            int start = w % _capacity;
+            int first = std::min<int>(count, _capacity - start);
+            memcpy(&_buffer[start], data, first * sizeof(T));
+            if (first < count) { memcpy(_buffer, &data[first], (count - first) * sizeof(T)); }
+            writer.pos.store(w + count);
+            notifyReader();
+            return count;
+        }
+
+        inline int pop(T* data, int count) {
+            uint64_t r = reader.pos.load(std::memory_order_relaxed);
+            if (data) {
+                int start = r % _capacity;
+                int first = std::min<int>(count, _capacity - start);
+                memcpy(data, &_buffer[start], first * sizeof(T));
+                if (first < count) { memcpy(&data[first], _buffer, (count - first) * sizeof(T)); }
+            }
+            reader.pos.store(r + count);
+            notifyWriter();
+            return count;
+        }
+
+        inline void handleFlush() {
+            if (!flushRequested.load(std::memory_order_relaxed) || !flushRequested.exchange(false)) { return; }
+            reader.otherPos = writer.pos.load();
+            reader.pos.store(reader.otherPos);
+            notifyWriter();
+        }
+
+        // Wait for at least one sample of space, returning all that's free up to what's wanted
+        int waitWritable(int want) {
+            int space = 0;
+            wait([this, &space, want]() { return (space = writable(want)) > 0 || writerStop.load(); }, writeCV, writerParked, true);
+            return writerStop.load() ? -1 : space;
+        }
+
+        // Wait for at least one sample, returning all that's available up to what's wanted
+        int waitReadable(int want) {
+            handleFlush();
+            int avail = 0;
+            wait([this, &avail, want]() { return (avail = readable(want)) > 0 || readerStop.load(); }, readCV, readerParked, false);
+            return readerStop.load() ? -1 : avail;
+        }
+
+        template <class Pred>
+        inline void wait(Pred pred, std::condition_variable& cv, std::atomic<bool>& parked, bool timed) {
+            // Spin for a little while, most of the time the other side is about to catch up
+            for (int i = 0; i < FIFO_SPIN_COUNT; i++) {
+                if (pred()) { return; }
+                if (i >= FIFO_SPIN_COUNT / 2) { std::this_thread::yield(); }
+            }
+
+            // Park until notified. The flag is set before the predicate is checked again, so a counter
+            // update either is seen here or sees the flag.
+            std::unique_lock<std::mutex> lck(parkMtx);
+            parked = true;
+            if (timed) {
+                while (!cv.wait_for(lck, std::chrono::microseconds(FIFO_WRITER_PARK_TIMEOUT_US), pred)) {}
+            }
+            else {
+                cv.wait(lck, pred);
+            }
+            parked = false;
+        }
+
+        // Avoid the syscall entirely unless the other side is actually parked
+        inline void notifyReader() {
+            if (!readerParked.load()) { return; }
+            {
+                std::lock_guard<std::mutex> lck(parkMtx);
+            }
+            readCV.notify_all();
+        }
+
+        // Called by the reader, must not block so the park mutex isn't taken
+        inline void notifyWriter() {
+            if (!writerParked.load()) { return; }
+            writeCV.notify_all();
+        }
+
+        // Counter of a side and its cached copy of the other side's counter, on a cache line of their own
+        struct alignas(64) Side {
+            std::atomic<uint64_t> pos = 0;
+            uint64_t otherPos = 0;
+        };
+
+        bool _init = false;
+        T* _buffer;
+        int _capacity;
+
+        Side writer;
+        Side reader;
+
+        std::atomic<uint64_t> overflows = 0;
+        std::atomic<uint64_t> underflows = 0;
+        std::atomic<bool> flushRequested = false;
+
+        std::mutex parkMtx;
+        std::condition_variable writeCV;
+        std::condition_variable readCV;
+        std::atomic<bool> writerParked = false;
+        std::atomic<bool> readerParked = false;
+
+        std::atomic<bool> readerStop = false;
+        std::atomic<bool> writerStop = false;
+    };
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "../processor.h"
+
+namespace dsp::buffer {
+    // Cuts the input into frames of 'size' samples. Consecutive frames start 'step' samples apart (frames
+    // overlap if step is smaller than size), and after every 'frames' frames, 'skip' samples are dropped.
+    // Output chunks always hold a whole number of frames. With frames=1 and step=size this is equivalent
+    // to a Reshaper with a positive skip.
+    template <class T>
+    class Framer : public Processor<T, T> {
+        using base_type = Processor<T, T>;
+    public:
+        Framer() {}
+
+        Framer(stream<T>* in, int size, int step, int frames, int skip) { init(in, size, step, frames, skip); }
+
+        ~Framer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(frameBuf);
+        }
+
+        void init(stream<T>* in, int size, int step, int frames, int skip) {
+            _size = size;
+            _step = step;
+            _frames = frames;
+            _skip = skip;
+            frameBuf = buffer::alloc<T>(_size);
+            base_type::init(in);
+
+            // Overlapping frames can take more than one output chunk per input chunk
+            base_type::schedulable = false;
+        }
+
+        void setFraming(int size, int step, int frames, int skip) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            if (size != _size) {
+                buffer::free(frameBuf);
+                frameBuf = buffer::alloc<T>(size);
+            }
+            _size = size;
+            _step = step;
+            _frames = frames;
+            _skip = skip;
+            fill = 0;
+            frameId = 0;
+            skipLeft = 0;
+            base_type::tempStart();
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            fill = 0;
+            frameId = 0;
+            skipLeft = 0;
+            base_type::tempStart();
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            const T* in = base_type::_in->readBuf;
+            int outCount = 0;
+            int maxOut = (STREAM_BUFFER_SIZE / _size) * _size;
+            for (int i = 0; i < count;) {
+                // Drop the samples between groups of frames
+                if (skipLeft) {
+                    int toSkip = std::min<int>(skipLeft, count - i);
+                    skipLeft -= toSkip;
+                    i += toSkip;
+                    continue;
+                }
+
+                // Fill the current frame
+                int toCopy = std::min<int>(_size - fill, count - i);
+                memcpy(&frameBuf[fill], &in[i], toCopy * sizeof(T));
+                fill += toCopy;
+                i += toCopy;
+                if (fill < _size) { break; }
+
+                // Output the frame, sending out the chunk if it's full
+                memcpy(&base_type::out.writeBuf[outCount], frameBuf, _size * sizeof(T));
+                outCount += _size;
+                if (outCount >= maxOut) {
+                    if (!base_type::out.swap(outCount)) {
+                        base_type::_in->flush();
+                        return -1;
+                    }
+                    outCount = 0;
+                }
+
+                // Start the next frame with the overlapping samples, or skip after a full group
+                if (++frameId >= _frames) {
+                    frameId = 0;
+                    fill = 0;
+                    skipLeft = _skip;
+                }
+                else if (_step < _size) {
+                    memmove(frameBuf, &frameBuf[_step], (_size - _step) * sizeof(T));
+                    fill = _size - _step;
+                }
+                else {
+                    fill = 0;
+                    skipLeft = _step - _size;
+                }
+            }
+
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return count;
+        }
+
+    protected:
+        int _size;
+        int _step;
+        int _frames;
+        int _skip;
+
+        T* frameBuf;
+        int fill = 0;
+        int frameId = 0;
+        int skipLeft = 0;
+    };
+}
@@ -12,6 +12,8 @@ namespace dsp::buffer {
         void init(stream<T>* in, int count) {
             _in = in;
             samples = count;
+            // Swaps the output once per packet, possibly several times per run
+            block::schedulable = false;
             block::registerInput(_in);
             block::registerOutput(&out);
             block::_block_init = true;
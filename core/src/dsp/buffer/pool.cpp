@@ -0,0 +1,293 @@
+#include "pool.h"
+#include "../stream.h"
+#include <volk/volk.h>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Bytes reserved in front of each block, also the alignment of the blocks
+#define POOL_HEADER_SIZE        64
+
+// Smallest block for which cached pages are returned to the OS and residency is measured
+#define POOL_RELEASE_MIN_BYTES  (256 * 1024)
+
+// Freed blocks beyond this total capacity are given back to the system instead of being cached
+#define POOL_MAX_CACHED_BYTES   ((size_t)64 * 1024 * 1024)
+
+namespace dsp::buffer {
+    struct Pool::Header {
+        Header* prev;
+        Header* next;
+        size_t capacity;
+        int sizeClass;
+#ifdef _WIN32
+        bool virtualAlloc;  // Allocated with VirtualAlloc so that its pages can be decommitted while cached
+#endif
+    };
+
+    static inline uint8_t* body(void* hdr) {
+        return (uint8_t*)hdr + POOL_HEADER_SIZE;
+    }
+
+    static size_t pageSize() {
+#ifdef _WIN32
+        static const size_t page = []() { SYSTEM_INFO info; GetSystemInfo(&info); return (size_t)info.dwPageSize; }();
+#else
+        static const size_t page = sysconf(_SC_PAGESIZE);
+#endif
+        return page;
+    }
+
+    // Page aligned part of a block, the only part that can be released or checked for residency
+    static bool pageRange(void* hdr, size_t capacity, uint8_t*& start, size_t& len) {
+        const uintptr_t page = pageSize();
+        uintptr_t begin = ((uintptr_t)body(hdr) + page - 1) & ~(page - 1);
+        uintptr_t end = ((uintptr_t)body(hdr) + capacity) & ~(page - 1);
+        if (end <= begin) { return false; }
+        start = (uint8_t*)begin;
+        len = end - begin;
+        return true;
+    }
+
+    Pool::Header* Pool::allocBlock(size_t capacity, int cls) {
+        Header* hdr;
+#ifdef _WIN32
+        // Large blocks come straight from VirtualAlloc, the heap doesn't allow decommitting part of a block
+        bool virt = (capacity >= POOL_RELEASE_MIN_BYTES);
+        if (virt) {
+            hdr = (Header*)VirtualAlloc(NULL, POOL_HEADER_SIZE + capacity, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        }
+        else {
+            hdr = (Header*)volk_malloc(POOL_HEADER_SIZE + capacity, std::max<size_t>(POOL_HEADER_SIZE, volk_get_alignment()));
+        }
+        if (!hdr) { return NULL; }
+        hdr->virtualAlloc = virt;
+#else
+        hdr = (Header*)volk_malloc(POOL_HEADER_SIZE + capacity, std::max<size_t>(POOL_HEADER_SIZE, volk_get_alignment()));
+        if (!hdr) { return NULL; }
+#endif
+        hdr->capacity = capacity;
+        hdr->sizeClass = cls;
+        return hdr;
+    }
+
+    void Pool::freeBlock(Header* hdr) {
+#ifdef _WIN32
+        if (hdr->virtualAlloc) {
+            VirtualFree(hdr, 0, MEM_RELEASE);
+            return;
+        }
+#endif
+        volk_free(hdr);
+    }
+
+    // Return the pages of a large cached block to the OS, they're mapped again on first write once reused
+    void Pool::releasePages(Header* hdr) {
+        uint8_t* start;
+        size_t len;
+        if (hdr->capacity < POOL_RELEASE_MIN_BYTES || !pageRange(hdr, hdr->capacity, start, len)) { return; }
+#if defined(_WIN32)
+        if (hdr->virtualAlloc) { VirtualFree(start, len, MEM_DECOMMIT); }
+#elif defined(__APPLE__)
+        madvise(start, len, MADV_FREE);
+#else
+        madvise(start, len, MADV_DONTNEED);
+#endif
+    }
+
+    // Undo releasePages() before a cached block is handed out again
+    bool Pool::reclaimPages(Header* hdr) {
+#ifdef _WIN32
+        uint8_t* start;
+        size_t len;
+        if (!hdr->virtualAlloc || !pageRange(hdr, hdr->capacity, start, len)) { return true; }
+        return VirtualAlloc(start, len, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+        return true;
+#endif
+    }
+
+    int Pool::sizeClass(size_t bytes, size_t& capacity) {
+        // Four classes per octave, so at most a quarter of a block is wasted
+        if (bytes <= POOL_HEADER_SIZE) {
+            capacity = POOL_HEADER_SIZE;
+            return 0;
+        }
+        int octave = 63 - __builtin_clzll((unsigned long long)(bytes - 1));
+        size_t base = (size_t)1 << octave;
+        int quarter = (int)((bytes - base + (base / 4) - 1) / (base / 4));
+        capacity = base + quarter * (base / 4);
+        return octave * 4 + quarter;
+    }
+
+    void* Pool::alloc(size_t bytes) {
+        static_assert(sizeof(Header) <= POOL_HEADER_SIZE);
+        size_t capacity;
+        int cls = sizeClass(bytes, capacity);
+
+        std::lock_guard<std::mutex> lck(mtx);
+
+        // Reuse a cached block if one of the right class is available
+        Header* hdr = NULL;
+        auto it = cache.find(cls);
+        if (it != cache.end() && !it->second.empty()) {
+            hdr = it->second.back();
+            it->second.pop_back();
+            stats.cachedBytes -= hdr->capacity;
+            stats.cachedCount--;
+            if (!reclaimPages(hdr)) {
+                freeBlock(hdr);
+                return NULL;
+            }
+        }
+        else {
+            hdr = allocBlock(capacity, cls);
+            if (!hdr) { return NULL; }
+        }
+
+        // Add it to the list of live blocks
+        hdr->prev = NULL;
+        hdr->next = live;
+        if (live) { live->prev = hdr; }
+        live = hdr;
+        stats.liveBytes += capacity;
+        stats.liveCount++;
+        stats.peakBytes = std::max<size_t>(stats.peakBytes, stats.liveBytes);
+
+        return body(hdr);
+    }
+
+    void Pool::free(void* ptr) {
+        if (!ptr) { return; }
+        Header* hdr = (Header*)((uint8_t*)ptr - POOL_HEADER_SIZE);
+
+        std::lock_guard<std::mutex> lck(mtx);
+
+        // Remove it from the list of live blocks
+        if (hdr->prev) { hdr->prev->next = hdr->next; }
+        else { live = hdr->next; }
+        if (hdr->next) { hdr->next->prev = hdr->prev; }
+        stats.liveBytes -= hdr->capacity;
+        stats.liveCount--;
+
+        // Give it back to the system if the cache is full
+        if (stats.cachedBytes + hdr->capacity > POOL_MAX_CACHED_BYTES) {
+            freeBlock(hdr);
+            return;
+        }
+
+        releasePages(hdr);
+
+        cache[hdr->sizeClass].push_back(hdr);
+        stats.cachedBytes += hdr->capacity;
+        stats.cachedCount++;
+    }
+
+    void Pool::trim() {
+        std::lock_guard<std::mutex> lck(mtx);
+        for (auto& [cls, blocks] : cache) {
+            for (auto& hdr : blocks) { freeBlock(hdr); }
+        }
+        cache.clear();
+        stats.cachedBytes = 0;
+        stats.cachedCount = 0;
+    }
+
+    void Pool::registerStream(untyped_stream* stream) {
+        std::lock_guard<std::mutex> lck(streamsMtx);
+        streams.insert(stream);
+    }
+
+    void Pool::unregisterStream(untyped_stream* stream) {
+        std::lock_guard<std::mutex> lck(streamsMtx);
+        streams.erase(stream);
+    }
+
+    Pool::Stats Pool::getStats() {
+        Stats s;
+        {
+            std::lock_guard<std::mutex> lck(mtx);
+            s = stats;
+
+            // Small blocks are counted as resident, large ones are checked page by page
+            s.residentBytes = 0;
+            for (Header* hdr = live; hdr; hdr = hdr->next) {
+#ifndef _WIN32
+                uint8_t* start;
+                size_t len;
+                if (hdr->capacity >= POOL_RELEASE_MIN_BYTES && pageRange(hdr, hdr->capacity, start, len)) {
+                    const size_t page = pageSize();
+                    std::vector<unsigned char> vec((len + page - 1) / page);
+#ifdef __APPLE__
+                    if (mincore(start, len, (char*)vec.data())) { s.residentBytes += hdr->capacity; continue; }
+#else
+                    if (mincore(start, len, vec.data())) { s.residentBytes += hdr->capacity; continue; }
+#endif
+                    s.residentBytes += (hdr->capacity - len);
+                    for (auto& v : vec) {
+                        if (v & 1) { s.residentBytes += page; }
+                    }
+                    continue;
+                }
+#endif
+                s.residentBytes += hdr->capacity;
+            }
+        }
+
+        std::lock_guard<std::mutex> lck(streamsMtx);
+        s.streamBytes = 0;
+        s.streamUsedBytes = 0;
+        s.streamCount = 0;
+        for (auto& stream : streams) {
+            // Streams of sub-blocks usually have their buffers freed, they don't count
+            size_t bytes = stream->getBufferBytes();
+            if (!bytes) { continue; }
+            s.streamBytes += bytes;
+            s.streamUsedBytes += stream->getUsedBytes();
+            s.streamCount++;
+        }
+        return s;
+    }
+
+    std::string Pool::report() {
+        Stats s = getStats();
+        const double MB = 1024.0 * 1024.0;
+        char line[256];
+        std::string out;
+        snprintf(line, sizeof(line), "DSP buffers: %.1f MB allocated in %zu blocks (%.1f MB resident, peak %.1f MB), %.1f MB cached in %zu blocks\n",
+                 s.liveBytes / MB, s.liveCount, s.residentBytes / MB, s.peakBytes / MB, s.cachedBytes / MB, s.cachedCount);
+        out += line;
+        snprintf(line, sizeof(line), "Streams: %zu holding %.1f MB, %.1f MB used by their largest chunks\n", s.streamCount, s.streamBytes / MB, s.streamUsedBytes / MB);
+        out += line;
+
+        // List the streams, largest first
+        std::vector<std::pair<size_t, size_t>> sizes;
+        std::vector<untyped_stream*> list;
+        {
+            std::lock_guard<std::mutex> lck(streamsMtx);
+            list.assign(streams.begin(), streams.end());
+            for (auto& stream : list) { sizes.push_back({ stream->getBufferBytes(), stream->getUsedBytes() }); }
+        }
+        std::vector<int> order(list.size());
+        for (int i = 0; i < order.size(); i++) { order[i] = i; }
+        std::sort(order.begin(), order.end(), [&sizes](int a, int b) { return sizes[a].first > sizes[b].first; });
+        for (int i : order) {
+            if (!sizes[i].first) { continue; }
+            snprintf(line, sizeof(line), "  stream %p: %.2f MB, largest chunks %.2f MB\n", (void*)list[i], sizes[i].first / MB, sizes[i].second / MB);
+            out += line;
+        }
+        return out;
+    }
+
+    Pool& getPool() {
+        // Never destroyed so that buffers freed during static destruction can still be returned
+        static Pool* pool = new Pool;
+        return *pool;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+namespace dsp {
+    class untyped_stream;
+}
+
+namespace dsp::buffer {
+    // Allocator behind buffer::alloc() and buffer::free(). Blocks are rounded up to a size class (four per
+    // octave) and freed blocks are kept per class to be handed out again, so creating and destroying DSP
+    // chains doesn't go back to the system every time. The pages of large cached blocks are returned to the
+    // OS while they wait (madvise on POSIX, decommitted on Windows), so the memory actually used by a buffer
+    // only ever follows the largest chunk written to it. Buffers are not resized to that chunk since writers
+    // don't check the capacity, streams only register themselves so that their real chunk sizes can be reported.
+    class Pool {
+    public:
+        struct Stats {
+            size_t liveBytes = 0;       // Capacity of the blocks in use
+            size_t liveCount = 0;
+            size_t residentBytes = 0;   // Part of liveBytes actually backed by memory
+            size_t cachedBytes = 0;     // Capacity of the freed blocks kept for reuse
+            size_t cachedCount = 0;
+            size_t peakBytes = 0;       // Highest liveBytes so far
+            size_t streamBytes = 0;     // Capacity of the registered streams' buffers
+            size_t streamUsedBytes = 0; // Part of streamBytes written by the largest chunk of each stream
+            size_t streamCount = 0;
+        };
+
+        void* alloc(size_t bytes);
+        void free(void* ptr);
+
+        // Give all cached blocks back to the system
+        void trim();
+
+        void registerStream(untyped_stream* stream);
+        void unregisterStream(untyped_stream* stream);
+
+        // Measuring resident memory walks all live blocks, it's meant for status displays, not for hot paths
+        Stats getStats();
+
+        // Human readable summary followed by one line per stream, largest first
+        std::string report();
+
+    private:
+        struct Header;
+
+        static int sizeClass(size_t bytes, size_t& capacity);
+        static Header* allocBlock(size_t capacity, int cls);
+        static void freeBlock(Header* hdr);
+        static void releasePages(Header* hdr);
+        static bool reclaimPages(Header* hdr);
+
+        std::mutex mtx;
+        Header* live = NULL;
+        std::map<int, std::vector<Header*>> cache;
+        Stats stats;
+
+        std::mutex streamsMtx;
+        std::set<untyped_stream*> streams;
+    };
+
+    // Pool shared by the core and all modules
+    Pool& getPool();
+}
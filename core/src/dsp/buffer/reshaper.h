@@ -1,6 +1,6 @@
 #pragma once
 #include "../block.h"
-#include "ring_buffer.h"
+#include "fifo.h"
 
 // IMPORTANT: THIS IS TRASH AND MUST BE REWRITTEN IN THE FUTURE
 
@@ -25,7 +25,7 @@ namespace dsp::buffer {
             _in = in;
             _keep = keep;
             _skip = skip;
-            ringBuf.init(keep * 2);
+            fifo.init(keep * 2);
             base_type::registerInput(_in);
             base_type::registerOutput(&out);
             base_type::_block_init = true;
@@ -46,7 +46,7 @@ namespace dsp::buffer {
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
             _keep = keep;
-            ringBuf.setMaxLatency(keep * 2);
+            fifo.setCapacity(keep * 2);
             base_type::tempStart();
         }
 
@@ -61,7 +61,7 @@ namespace dsp::buffer {
         int run() override {
             int count = _in->read();
             if (count < 0) { return -1; }
-            ringBuf.write(_in->readBuf, count);
+            fifo.write(_in->readBuf, count);
             _in->flush();
             return count;
         }
@@ -81,9 +81,9 @@ namespace dsp::buffer {
 
         void doStop() override {
             _in->stopReader();
-            ringBuf.stopReader();
+            fifo.stopReader();
             out.stopWriter();
-            ringBuf.stopWriter();
+            fifo.stopWriter();
 
             if (workThread.joinable()) {
                 workThread.join();
@@ -93,9 +93,9 @@ namespace dsp::buffer {
             }
 
             _in->clearReadStop();
-            ringBuf.clearReadStop();
+            fifo.clearReadStop();
             out.clearWriteStop();
-            ringBuf.clearWriteStop();
+            fifo.clearWriteStop();
         }
 
         void bufferWorker() {
@@ -120,7 +120,8 @@ namespace dsp::buffer {
                         }
                     }
                 }
-                if (ringBuf.readAndSkip(start, readCount, skip) < 0) { break; };
+                if (fifo.read(start, readCount) < 0) { break; };
+                if (skip && fifo.skip(skip) < 0) { break; }
                 memcpy(out.writeBuf, buf, _keep * sizeof(T));
                 if (!out.swap(_keep)) { break; }
             }
@@ -129,7 +130,7 @@ namespace dsp::buffer {
 
         stream<T>* _in;
         int _outBlockSize;
-        RingBuffer<T> ringBuf;
+        FIFO<T> fifo;
         std::thread bufferWorkerThread;
         std::thread workThread;
         int _keep, _skip;
@@ -0,0 +1,114 @@
+#pragma once
+#include "../block.h"
+#include "fifo.h"
+
+namespace dsp::buffer {
+    // Decouples its input from its output through a FIFO so that a slow consumer doesn't stall the producer.
+    // Input chunks are written without waiting, what doesn't fit is dropped and counted in getOverflows().
+    // A second thread reads whatever is available and outputs it in chunks of at most STREAM_BUFFER_SIZE.
+    template <class T>
+    class SampleFIFO : public block {
+        using base_type = block;
+    public:
+        SampleFIFO() {}
+
+        SampleFIFO(stream<T>* in, int capacity) { init(in, capacity); }
+
+        ~SampleFIFO() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+        }
+
+        void init(stream<T>* in, int capacity) {
+            _in = in;
+            fifo.init(capacity);
+            base_type::registerInput(_in);
+            base_type::registerOutput(&out);
+            base_type::_block_init = true;
+        }
+
+        void setInput(stream<T>* in) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            base_type::unregisterInput(_in);
+            _in = in;
+            base_type::registerInput(_in);
+            base_type::tempStart();
+        }
+
+        void setCapacity(int capacity) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            fifo.setCapacity(capacity);
+            base_type::tempStart();
+        }
+
+        // When bypassed, the producer waits for space instead of dropping samples
+        void setBypass(bool bypass) {
+            _bypass = bypass;
+        }
+
+        // Discard the buffered samples, can be called from any thread
+        void flush() {
+            fifo.flush();
+        }
+
+        int available() { return fifo.available(); }
+        int getCapacity() { return fifo.getCapacity(); }
+        uint64_t getOverflows() { return fifo.getOverflows(); }
+
+        int run() {
+            int count = _in->read();
+            if (count < 0) { return -1; }
+
+            // The output is always written by the reading thread, so bypassing only changes how overflows are handled
+            if (_bypass) {
+                if (fifo.write(_in->readBuf, count) < 0) { return -1; }
+            }
+            else {
+                fifo.tryWrite(_in->readBuf, count);
+            }
+
+            _in->flush();
+            return count;
+        }
+
+        stream<T> out;
+
+    private:
+        void worker() {
+            while (true) {
+                int count = fifo.readSome(out.writeBuf, STREAM_BUFFER_SIZE);
+                if (count < 0) { break; }
+                if (!out.swap(count)) { break; }
+            }
+        }
+
+        void doStart() {
+            base_type::workerThread = std::thread(&SampleFIFO<T>::workerLoop, this);
+            readWorkerThread = std::thread(&SampleFIFO<T>::worker, this);
+        }
+
+        void doStop() {
+            _in->stopReader();
+            out.stopWriter();
+            fifo.stopWriter();
+            fifo.stopReader();
+
+            if (base_type::workerThread.joinable()) { base_type::workerThread.join(); }
+            if (readWorkerThread.joinable()) { readWorkerThread.join(); }
+
+            _in->clearReadStop();
+            out.clearWriteStop();
+            fifo.clearWriteStop();
+            fifo.clearReadStop();
+        }
+
+        stream<T>* _in;
+        FIFO<T> fifo;
+        std::atomic<bool> _bypass = false;
+        std::thread readWorkerThread;
+    };
+}
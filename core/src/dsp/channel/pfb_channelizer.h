@@ -0,0 +1,245 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <fftw3.h>
+#include "../fftw_planner.h"
+#include "../sink.h"
+#include "../taps/low_pass.h"
+
+namespace dsp::channel {
+    // 2x oversampled polyphase filter bank channelizer. The input is split into 'channels' evenly
+    // spaced sub-channels, channel k being centered on k * samplerate / channels (channels above
+    // half the count are the negative frequencies). Each channel is output at 2 * samplerate / channels
+    // and is flat over +-0.75 channel spacing so that any signal narrow enough can be taken from the
+    // nearest channel. The cost per input sample doesn't depend on the number of channels.
+    // Only channels with bound streams are output.
+    class PFBChannelizer : public Sink<complex_t> {
+        using base_type = Sink<complex_t>;
+    public:
+        PFBChannelizer() {}
+
+        PFBChannelizer(stream<complex_t>* in, int channels) { init(in, channels); }
+
+        ~PFBChannelizer() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            freeBank();
+        }
+
+        void init(stream<complex_t>* in, int channels) {
+            _channels = channels;
+            buffer = buffer::alloc<complex_t>(STREAM_BUFFER_SIZE + 64000);
+            generateBank();
+            base_type::init(in);
+        }
+
+        void setChannelCount(int channels) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+
+            // Channels indices change meaning, so all bound streams are dropped
+            for (auto& [ch, streams] : channelStreams) {
+                for (auto& s : streams) { base_type::unregisterOutput(s); }
+            }
+            channelStreams.clear();
+
+            _channels = channels;
+            freeBank();
+            generateBank();
+
+            base_type::tempStart();
+        }
+
+        int getChannelCount() {
+            return _channels;
+        }
+
+        // Ratio between the input samplerate and the samplerate of each channel
+        double getDecimation() {
+            return (double)_decim;
+        }
+
+        void bindStream(int channel, stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            if (channel < 0 || channel >= _channels) {
+                throw std::runtime_error("[PFBChannelizer] Tried to bind stream to a channel that doesn't exist");
+            }
+            auto cit = channelStreams.find(channel);
+            if (cit != channelStreams.end() && std::find(cit->second.begin(), cit->second.end(), stream) != cit->second.end()) {
+                throw std::runtime_error("[PFBChannelizer] Tried to bind stream to that is already bound");
+            }
+
+            // The map is only modified by the worker while running, the other channels keep being output
+            base_type::updateSync([this, channel, stream]() {
+                base_type::registerOutput(stream);
+                channelStreams[channel].push_back(stream);
+            });
+        }
+
+        void unbindStream(int channel, stream<complex_t>* stream) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            auto cit = channelStreams.find(channel);
+            if (cit == channelStreams.end()) {
+                throw std::runtime_error("[PFBChannelizer] Tried to unbind stream to that isn't bound");
+            }
+            auto& streams = cit->second;
+            auto sit = std::find(streams.begin(), streams.end(), stream);
+            if (sit == streams.end()) {
+                throw std::runtime_error("[PFBChannelizer] Tried to unbind stream to that isn't bound");
+            }
+
+            // Once this returns the stream is no longer written to
+            base_type::updateSync([this, channel, stream]() {
+                auto& streams = channelStreams[channel];
+                streams.erase(std::find(streams.begin(), streams.end(), stream));
+                if (streams.empty()) { channelStreams.erase(channel); }
+                base_type::unregisterOutput(stream);
+            });
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            buffer::clear(buffer, tapCount - 1);
+            offset = 0;
+            oddFrame = false;
+            base_type::tempStart();
+        }
+
+        // Process samples, writing the output of each channel listed in activeOutputs to its buffer
+        inline int process(int count, const complex_t* in) {
+            // Copy data to work buffer
+            memcpy(bufStart, in, count * sizeof(complex_t));
+
+            int outCount = 0;
+            for (; offset < count; offset += _decim) {
+                // Polyphase partial sums, the branch taps are stored reversed so that each one is a contiguous MAC
+                complex_t* acc = (complex_t*)fftIn;
+                buffer::clear(acc, _channels);
+                for (int p = 0; p < tapsPerBranch; p++) {
+                    const complex_t* data = &buffer[offset + tapCount - _channels - (p * _channels)];
+                    const float* h = bank[p];
+                    for (int j = 0; j < _channels; j++) {
+                        acc[j].re += data[j].re * h[j];
+                        acc[j].im += data[j].im * h[j];
+                    }
+                }
+
+                // DFT across branches
+                fftwf_execute(plan);
+
+                // Correct the phase rotation due to 2x oversampling, (-1)^(k*n) for odd channels of odd frames
+                complex_t* res = (complex_t*)fftOut;
+                for (auto& [ch, o] : activeOutputs) {
+                    complex_t val = res[ch];
+                    if (oddFrame && (ch & 1)) { val = val * -1.0f; }
+                    o[outCount] = val;
+                }
+                oddFrame = !oddFrame;
+                outCount++;
+            }
+            offset -= count;
+
+            // Move unused data
+            memmove(buffer, &buffer[count], (tapCount - 1) * sizeof(complex_t));
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            // Gather the output buffers of the channels in use, the first stream of a channel is written directly
+            activeOutputs.clear();
+            for (auto& [ch, streams] : channelStreams) {
+                activeOutputs.push_back({ ch, streams[0]->writeBuf });
+            }
+
+            int outCount = process(count, base_type::_in->readBuf);
+            base_type::_in->flush();
+            if (!outCount) { return count; }
+
+            // Send out all channels in use
+            for (auto& [ch, streams] : channelStreams) {
+                for (int i = 1; i < streams.size(); i++) {
+                    memcpy(streams[i]->writeBuf, streams[0]->writeBuf, outCount * sizeof(complex_t));
+                }
+                for (auto& s : streams) {
+                    if (!s->swap(outCount)) { return -1; }
+                }
+            }
+
+            return count;
+        }
+
+    protected:
+        void generateBank() {
+            _decim = _channels / 2;
+
+            // Prototype filter: flat to 0.75 channel spacing, stopband from 1.25 so that the aliases from decimating by channels/2 stay out of the flat region
+            tap<float> proto = taps::lowPass(1.0 / (double)_channels, 0.5 / (double)_channels, 1.0);
+            tapsPerBranch = (proto.size + _channels - 1) / _channels;
+            tapCount = tapsPerBranch * _channels;
+
+            // Split in branches. Branch m gets h[m + p*M], stored reversed (index M-1-m) to match the order of samples in the delay line.
+            // A forward DFT of the branch sums in reversed order is equal to the IDFT in natural order up to a constant phase per channel.
+            bank.resize(tapsPerBranch);
+            for (int p = 0; p < tapsPerBranch; p++) {
+                bank[p] = buffer::alloc<float>(_channels);
+                for (int j = 0; j < _channels; j++) {
+                    int i = (_channels - 1 - j) + p * _channels;
+                    bank[p][j] = (i < proto.size) ? proto.taps[i] : 0.0f;
+                }
+            }
+            taps::free(proto);
+
+            // Delay line
+            bufStart = &buffer[tapCount - 1];
+            buffer::clear(buffer, tapCount - 1);
+            offset = 0;
+            oddFrame = false;
+
+            // FFT
+            fftIn = (fftwf_complex*)fftwf_malloc(_channels * sizeof(fftwf_complex));
+            fftOut = (fftwf_complex*)fftwf_malloc(_channels * sizeof(fftwf_complex));
+            std::lock_guard<std::mutex> lck(getFFTWPlannerMutex());
+            plan = fftwf_plan_dft_1d(_channels, fftIn, fftOut, FFTW_FORWARD, FFTW_ESTIMATE);
+        }
+
+        void freeBank() {
+            for (auto& b : bank) { buffer::free(b); }
+            bank.clear();
+            {
+                std::lock_guard<std::mutex> lck(getFFTWPlannerMutex());
+                fftwf_destroy_plan(plan);
+            }
+            fftwf_free(fftIn);
+            fftwf_free(fftOut);
+        }
+
+        int _channels;
+        int _decim;
+        int tapsPerBranch;
+        int tapCount;
+        std::vector<float*> bank;
+
+        complex_t* buffer;
+        complex_t* bufStart;
+        int offset = 0;
+        bool oddFrame = false;
+
+        fftwf_complex* fftIn;
+        fftwf_complex* fftOut;
+        fftwf_plan plan;
+
+        std::map<int, std::vector<stream<complex_t>*>> channelStreams;
+        std::vector<std::pair<int, complex_t*>> activeOutputs;
+    };
+}
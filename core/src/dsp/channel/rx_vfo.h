@@ -1,8 +1,14 @@
 #pragma once
+#include <vector>
+#include <mutex>
 #include "frequency_xlator.h"
+#include "xlating_decimator.h"
 #include "../multirate/rational_resampler.h"
+#include "../filter/overlap_save_fir.h"
 
 namespace dsp::channel {
+    // The setters return before the change takes effect. Everything that allocates or plans (filter banks,
+    // FFT kernels) is built on the calling thread and the worker only swaps it in before its next chunk.
     class RxVFO : public Processor<complex_t, complex_t> {
         using base_type = Processor<complex_t, complex_t>;
     public:
@@ -13,6 +19,8 @@ namespace dsp::channel {
         ~RxVFO() {
             if (!base_type::_block_init) { return; }
             base_type::stop();
+            freeStages(stages);
+            freeRetired();
             taps::free(ftaps);
         }
 
@@ -22,58 +30,69 @@ namespace dsp::channel {
             _bandwidth = bandwidth;
             _offset = offset;
             filterNeeded = (_bandwidth != _outSamplerate);
-            ftaps.taps = NULL;
 
             xlator.init(NULL, -_offset, _inSamplerate);
-            resamp.init(NULL, _inSamplerate, _outSamplerate);
-            generateTaps();
+            stages = buildStages(_inSamplerate, _outSamplerate, _offset);
+            ftaps = designTaps(_bandwidth, _outSamplerate);
             filter.init(NULL, ftaps);
 
+            xlator.out.free();
+            filter.out.free();
+
             base_type::init(in);
         }
 
         void setInSamplerate(double inSamplerate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
+            freeRetired();
             _inSamplerate = inSamplerate;
-            xlator.setOffset(-_offset, _inSamplerate);
-            resamp.setInSamplerate(_inSamplerate);
-            base_type::tempStart();
+            Stages next = buildStages(_inSamplerate, _outSamplerate, _offset);
+            double offset = _offset;
+            base_type::update([this, next, inSamplerate, offset]() {
+                xlator.setOffset(-offset, inSamplerate);
+                swapStages(next);
+            });
         }
 
         void setOutSamplerate(double outSamplerate, double bandwidth) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
+            freeRetired();
             _outSamplerate = outSamplerate;
             _bandwidth = bandwidth;
-            filterNeeded = (_bandwidth != _outSamplerate);
-            resamp.setOutSamplerate(_outSamplerate);
-            if (filterNeeded) {
-                generateTaps();
-                filter.setTaps(ftaps);
-            }
-            base_type::tempStart();
+            Stages next = buildStages(_inSamplerate, _outSamplerate, _offset);
+            bool needed = (_bandwidth != _outSamplerate);
+            FilterTaps ft = prepareFilter(needed);
+            base_type::update([this, next, needed, ft]() mutable {
+                swapStages(next);
+                filterNeeded = needed;
+                if (needed) { filter.applyPrepared(ft); }
+            });
         }
 
         void setBandwidth(double bandwidth) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            std::lock_guard<std::mutex> lck2(filterMtx);
+            freeRetired();
             _bandwidth = bandwidth;
-            filterNeeded = (_bandwidth != _outSamplerate);
-            if (filterNeeded) {
-                generateTaps();
-                filter.setTaps(ftaps);
-            }
+            bool needed = (_bandwidth != _outSamplerate);
+            FilterTaps ft = prepareFilter(needed);
+            base_type::update([this, needed, ft]() mutable {
+                filterNeeded = needed;
+                if (needed) { filter.applyPrepared(ft); }
+            });
         }
 
         void setOffset(double offset) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             _offset = offset;
-            xlator.setOffset(-_offset, _inSamplerate);
+            double inSamplerate = _inSamplerate;
+            base_type::update([this, offset, inSamplerate]() {
+                xlator.setOffset(-offset, inSamplerate);
+                if (stages.xdecim) { stages.xdecim->setOffset(-offset, inSamplerate); }
+            });
         }
 
         void reset() {
@@ -81,19 +100,22 @@ namespace dsp::channel {
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
             xlator.reset();
-            resamp.reset();
+            if (stages.xdecim) { stages.xdecim->reset(); }
+            stages.resamp->reset();
             filter.reset();
             base_type::tempStart();
         }
 
         inline int process(int count, const complex_t* in, complex_t* out) {
-            xlator.process(count, in, out);
-            if (!filterNeeded) {
-                return resamp.process(count, out, out);
+            // The fused stage is the only one to run at the full input rate
+            if (stages.xdecim) {
+                count = stages.xdecim->process(count, in, out);
             }
-            count = resamp.process(count, out, out);
-            {
-                std::lock_guard<std::mutex> lck(filterMtx);
+            else {
+                xlator.process(count, in, out);
+            }
+            count = stages.resamp->process(count, out, out);
+            if (filterNeeded) {
                 filter.process(count, out, out);
             }
             return count;
@@ -114,23 +136,87 @@ namespace dsp::channel {
         }
 
     protected:
-        void generateTaps() {
-            taps::free(ftaps);
-            double filterWidth = _bandwidth / 2.0;
-            ftaps = taps::lowPass(filterWidth, filterWidth * 0.1, _outSamplerate);
+        using FilterTaps = filter::OverlapSaveFIR<complex_t, float>::Prepared;
+
+        // Rate dependent stages. When decimating, the translation is fused with the first stage the power decimator
+        // of the resampler would have used, and the resampler only does the rest.
+        struct Stages {
+            XlatingDecimator* xdecim = NULL;
+            multirate::RationalResampler<complex_t>* resamp = NULL;
+        };
+
+        static tap<float> designTaps(double bandwidth, double outSamplerate) {
+            double filterWidth = bandwidth / 2.0;
+            return taps::lowPass(filterWidth, filterWidth * 0.1, outSamplerate);
+        }
+
+        static Stages buildStages(double inSamplerate, double outSamplerate, double offset) {
+            // The CIC used for the largest ratios can't be fused
+            Stages st;
+            double ratio = std::min<double>(inSamplerate / outSamplerate, multirate::PowerDecimator<complex_t>::getMaxRatio());
+            unsigned int predecRatio = (ratio >= 2.0) ? (1 << (int)floor(log2(ratio))) : 1;
+            double resampInSamplerate = inSamplerate;
+            if (predecRatio >= 2 && predecRatio < POWER_DECIM_CIC_MIN_RATIO) {
+                unsigned int decimation;
+                tap<float> taps = multirate::PowerDecimator<complex_t>::firstStage(predecRatio, decimation);
+                st.xdecim = new XlatingDecimator(NULL, -offset, inSamplerate, taps, decimation);
+                st.xdecim->out.free();
+                taps::free(taps);
+                resampInSamplerate = inSamplerate / (double)decimation;
+            }
+            st.resamp = new multirate::RationalResampler<complex_t>(NULL, resampInSamplerate, outSamplerate);
+            st.resamp->out.free();
+            return st;
+        }
+
+        static void freeStages(Stages& st) {
+            if (st.xdecim) { delete st.xdecim; }
+            if (st.resamp) { delete st.resamp; }
+            st.xdecim = NULL;
+            st.resamp = NULL;
+        }
+
+        FilterTaps prepareFilter(bool needed) {
+            FilterTaps ft;
+            if (!needed) { return ft; }
+            tap<float> taps = designTaps(_bandwidth, _outSamplerate);
+            ft = filter.prepareTaps(taps);
+            taps::free(taps);
+            return ft;
+        }
+
+        // Called by the worker, the replaced stages are freed by the next setter or the destructor
+        void swapStages(const Stages& next) {
+            {
+                std::lock_guard<std::mutex> lck(retiredMtx);
+                retired.push_back(stages);
+            }
+            stages = next;
+        }
+
+        void freeRetired() {
+            std::vector<Stages> list;
+            {
+                std::lock_guard<std::mutex> lck(retiredMtx);
+                list.swap(retired);
+            }
+            for (auto& st : list) { freeStages(st); }
+            filter.freeRetired();
         }
 
         FrequencyXlator xlator;
-        multirate::RationalResampler<complex_t> resamp;
-        filter::FIR<complex_t, float> filter;
+        Stages stages;
+        filter::OverlapSaveFIR<complex_t, float> filter;
         tap<float> ftaps;
         bool filterNeeded;
 
+        std::mutex retiredMtx;
+        std::vector<Stages> retired;
+
+        // Latest settings, only used by the setters
         double _inSamplerate;
         double _outSamplerate;
         double _bandwidth;
         double _offset;
-
-        std::mutex filterMtx;
     };
 }
\ No newline at end of file
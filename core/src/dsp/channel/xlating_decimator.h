@@ -0,0 +1,134 @@
+#pragma once
+#include "../processor.h"
+#include "../taps/tap.h"
+#include "../taps/from_array.h"
+#include "../math/hz_to_rads.h"
+#include "../filter/decimating_fir.h"
+#include "../filter/half_band_decimator.h"
+
+// Number of input samples translated at once, small enough for the rotated chunk to stay in cache until it's decimated
+#define XLATING_DECIM_CHUNK_SIZE    4096
+
+namespace dsp::channel {
+    // Frequency translation fused with a first decimation stage. Each chunk of input is rotated into a small
+    // scratch buffer and decimated right away, so unlike a FrequencyXlator followed by a decimator, the full
+    // rate samples are read once and the translated ones are never written back to memory. Decimations by two
+    // with half-band taps (see taps::halfBand()) use a HalfBandDecimator, others use a DecimatingFIR.
+    class XlatingDecimator : public Processor<complex_t, complex_t> {
+        using base_type = Processor<complex_t, complex_t>;
+    public:
+        XlatingDecimator() {}
+
+        XlatingDecimator(stream<complex_t>* in, double offset, double samplerate, tap<float>& taps, int decimation) { init(in, offset, samplerate, taps, decimation); }
+
+        ~XlatingDecimator() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            freeStage();
+            buffer::free(scratch);
+        }
+
+        void init(stream<complex_t>* in, double offset, double samplerate, tap<float>& taps, int decimation) {
+            phase = lv_cmake(1.0f, 0.0f);
+            setPhaseDelta(offset, samplerate);
+            buildStage(taps, decimation);
+            scratch = buffer::alloc<complex_t>(XLATING_DECIM_CHUNK_SIZE);
+            base_type::init(in);
+        }
+
+        void setOffset(double offset, double samplerate) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            setPhaseDelta(offset, samplerate);
+        }
+
+        void setStage(tap<float>& taps, int decimation) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            freeStage();
+            buildStage(taps, decimation);
+            base_type::tempStart();
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            phase = lv_cmake(1.0f, 0.0f);
+            if (halfBand) { halfBand->reset(); }
+            else { fir->reset(); }
+            base_type::tempStart();
+        }
+
+        inline int process(int count, const complex_t* in, complex_t* out) {
+            // Outputs are always written behind the input that remains to be read, so this also works in place
+            int outCount = 0;
+            for (int i = 0; i < count; i += XLATING_DECIM_CHUNK_SIZE) {
+                int n = std::min<int>(XLATING_DECIM_CHUNK_SIZE, count - i);
+#if VOLK_VERSION >= 030100
+                volk_32fc_s32fc_x2_rotator2_32fc((lv_32fc_t*)scratch, (lv_32fc_t*)&in[i], &phaseDelta, &phase, n);
+#else
+                volk_32fc_s32fc_x2_rotator_32fc((lv_32fc_t*)scratch, (lv_32fc_t*)&in[i], phaseDelta, &phase, n);
+#endif
+                if (halfBand) {
+                    outCount += halfBand->process(n, scratch, &out[outCount]);
+                }
+                else {
+                    outCount += fir->process(n, scratch, &out[outCount]);
+                }
+            }
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        void setPhaseDelta(double offset, double samplerate) {
+            double rads = math::hzToRads(offset, samplerate);
+            phaseDelta = lv_cmake(cos(rads), sin(rads));
+        }
+
+        void buildStage(tap<float>& taps, int decimation) {
+            assert(decimation >= 2);
+            if (decimation == 2 && filter::HalfBandDecimator<complex_t>::isHalfBand(taps)) {
+                halfBand = new filter::HalfBandDecimator<complex_t>(NULL, taps);
+                halfBand->out.free();
+                return;
+            }
+
+            // The FIR only keeps a reference to its taps
+            ftaps = taps::fromArray<float>(taps.size, taps.taps);
+            fir = new filter::DecimatingFIR<complex_t, float>(NULL, ftaps, decimation);
+            fir->out.free();
+        }
+
+        void freeStage() {
+            if (halfBand) { delete halfBand; }
+            if (fir) { delete fir; }
+            halfBand = NULL;
+            fir = NULL;
+            taps::free(ftaps);
+        }
+
+        lv_32fc_t phase;
+        lv_32fc_t phaseDelta;
+
+        filter::HalfBandDecimator<complex_t>* halfBand = NULL;
+        filter::DecimatingFIR<complex_t, float>* fir = NULL;
+        tap<float> ftaps;
+        complex_t* scratch;
+    };
+}
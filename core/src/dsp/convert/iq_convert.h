@@ -0,0 +1,83 @@
+#pragma once
+#include <stdint.h>
+#include <volk/volk.h>
+#include "../types.h"
+
+namespace dsp::convert {
+    // Conversion of the interleaved integer IQ formats used by SDR hardware to complex samples. Each value
+    // becomes (x - offset) * scale, with I and Q optionally swapped. Signed formats without offset or swap
+    // go to the VOLK kernels, everything else uses loops written so that the compiler vectorizes them.
+    // 'count' is always in complex samples.
+
+    namespace detail {
+        template <class T>
+        inline void iqToFloat(float* __restrict out, const T* __restrict in, int count, float offset, float scale) {
+            // Folding the offset into a bias keeps the loop a single multiply-add per value
+            const float bias = -offset * scale;
+            for (int i = 0; i < count * 2; i++) {
+                out[i] = (float)in[i] * scale + bias;
+            }
+        }
+
+        template <class T>
+        inline void iqToFloatSwapped(float* __restrict out, const T* __restrict in, int count, float offset, float scale) {
+            const float bias = -offset * scale;
+            for (int i = 0; i < count; i++) {
+                out[2*i] = (float)in[2*i + 1] * scale + bias;
+                out[2*i + 1] = (float)in[2*i] * scale + bias;
+            }
+        }
+
+        template <class T>
+        inline void iqConvert(complex_t* out, const T* in, int count, float offset, float scale, bool swapIQ) {
+            if (swapIQ) {
+                iqToFloatSwapped<T>((float*)out, in, count, offset, scale);
+            }
+            else {
+                iqToFloat<T>((float*)out, in, count, offset, scale);
+            }
+        }
+    }
+
+    // Unsigned offset binary bytes, eg. RTL-SDR. The offset of the RTL2832U is usually taken as 127.4 or 127.5.
+    inline void u8ToComplex(complex_t* out, const uint8_t* in, int count, float offset = 127.5f, float scale = 1.0f / 128.0f, bool swapIQ = false) {
+        detail::iqConvert<uint8_t>(out, in, count, offset, scale, swapIQ);
+    }
+
+    // Signed bytes, eg. HackRF
+    inline void s8ToComplex(complex_t* out, const int8_t* in, int count, float offset = 0.0f, float scale = 1.0f / 128.0f, bool swapIQ = false) {
+        if (offset == 0.0f && !swapIQ) {
+            volk_8i_s32f_convert_32f((float*)out, in, 1.0f / scale, count * 2);
+            return;
+        }
+        detail::iqConvert<int8_t>(out, in, count, offset, scale, swapIQ);
+    }
+
+    // Signed 16bit little endian words, also used for ADCs of less than 16bit that are sign extended
+    inline void s16ToComplex(complex_t* out, const int16_t* in, int count, float offset = 0.0f, float scale = 1.0f / 32768.0f, bool swapIQ = false) {
+        if (offset == 0.0f && !swapIQ) {
+            volk_16i_s32f_convert_32f((float*)out, in, 1.0f / scale, count * 2);
+            return;
+        }
+        detail::iqConvert<int16_t>(out, in, count, offset, scale, swapIQ);
+    }
+
+    // Signed 12bit values packed two by two in three bytes, little endian: the first value is made of the
+    // first byte and the low nibble of the second, the second value of the high nibble and the third byte.
+    // 'in' must hold 3 * count bytes.
+    inline void s12PackedToComplex(complex_t* out, const uint8_t* in, int count, float offset = 0.0f, float scale = 1.0f / 2048.0f, bool swapIQ = false) {
+        const float bias = -offset * scale;
+        float* fout = (float*)out;
+        const int ii = swapIQ ? 1 : 0;
+        for (int i = 0; i < count; i++) {
+            const uint8_t* b = &in[3*i];
+
+            // Shift the 12 bits to the top of a 16bit word and back to sign extend them
+            int16_t a = (int16_t)(uint16_t)((b[0] << 4) | (b[1] << 12)) >> 4;
+            int16_t c = (int16_t)(uint16_t)((b[1] & 0xF0) | (b[2] << 8)) >> 4;
+
+            fout[2*i + ii] = (float)a * scale + bias;
+            fout[2*i + (ii ^ 1)] = (float)c * scale + bias;
+        }
+    }
+}
@@ -57,13 +57,13 @@ namespace dsp::demod {
 
         void setBandwidth(double bandwidth) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            if (bandwidth == _bandwidth) { return; }
-            _bandwidth = bandwidth;
-            std::lock_guard<std::mutex> lck2(lpfMtx);
-            taps::free(lpfTaps);
-            lpfTaps = taps::lowPass(_bandwidth / 2.0, (_bandwidth / 2.0) * 0.1, _samplerate);
-            lpf.setTaps(lpfTaps);
+            base_type::update([this, bandwidth]() {
+                if (bandwidth == _bandwidth) { return; }
+                _bandwidth = bandwidth;
+                taps::free(lpfTaps);
+                lpfTaps = taps::lowPass(_bandwidth / 2.0, (_bandwidth / 2.0) * 0.1, _samplerate);
+                lpf.setTaps(lpfTaps);
+            });
         }
 
         void setAGCAttack(double attack) {
@@ -111,10 +111,7 @@ namespace dsp::demod {
                 if (_agcMode == AGCMode::AUDIO) {
                     audioAgc.process(count, out, out);
                 }
-                {
-                    std::lock_guard<std::mutex> lck(lpfMtx);
-                    lpf.process(count, out, out);
-                }
+                lpf.process(count, out, out);
             }
             if constexpr (std::is_same_v<T, stereo_t>) {
                 volk_32fc_magnitude_32f(audioAgc.out.writeBuf, (lv_32fc_t*)in, count);
@@ -122,10 +119,7 @@ namespace dsp::demod {
                 if (_agcMode == AGCMode::AUDIO) {
                     audioAgc.process(count, audioAgc.out.writeBuf, audioAgc.out.writeBuf);
                 }
-                {
-                    std::lock_guard<std::mutex> lck(lpfMtx);
-                    lpf.process(count, audioAgc.out.writeBuf, audioAgc.out.writeBuf);
-                }
+                lpf.process(count, audioAgc.out.writeBuf, audioAgc.out.writeBuf);
                 convert::MonoToStereo::process(count, audioAgc.out.writeBuf, out);
             }
 
@@ -154,7 +148,6 @@ namespace dsp::demod {
         correction::DCBlocker<float> dcBlock;
         tap<float> lpfTaps;
         filter::FIR<float, float> lpf;
-        std::mutex lpfMtx;
 
     };
 }
\ No newline at end of file
@@ -2,7 +2,7 @@
 #include "quadrature.h"
 #include "../taps/low_pass.h"
 #include "../taps/band_pass.h"
-#include "../filter/fir.h"
+#include "../filter/overlap_save_fir.h"
 #include "../loop/pll.h"
 #include "../convert/l_r_to_stereo.h"
 #include "../convert/real_to_complex.h"
@@ -270,15 +270,15 @@ namespace dsp::demod {
 
         Quadrature demod;
         tap<complex_t> pilotFirTaps;
-        filter::FIR<complex_t, complex_t> pilotFir;
+        filter::OverlapSaveFIR<complex_t, complex_t> pilotFir;
         convert::RealToComplex rtoc;
         channel::FrequencyXlator xlator;
         loop::PLL pilotPLL;
         math::Delay<float> lprDelay;
         math::Delay<complex_t> lmrDelay;
         tap<float> audioFirTaps;
-        filter::FIR<float, float> arFir;
-        filter::FIR<float, float> alFir;
+        filter::OverlapSaveFIR<float, float> arFir;
+        filter::OverlapSaveFIR<float, float> alFir;
         multirate::RationalResampler<dsp::complex_t> rdsResamp;
 
         float* lmr;
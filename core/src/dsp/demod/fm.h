@@ -45,33 +45,31 @@ namespace dsp::demod {
 
         void setSamplerate(double samplerate) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _samplerate = samplerate;
-            demod.setDeviation(_bandwidth / 2.0, _samplerate);
-            updateFilter(_lowPass, _highPass);
-            base_type::tempStart();
+            base_type::update([this, samplerate]() {
+                _samplerate = samplerate;
+                demod.setDeviation(_bandwidth / 2.0, _samplerate);
+                updateFilter(_lowPass, _highPass);
+            });
         }
 
         void setBandwidth(double bandwidth) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            if (bandwidth == _bandwidth) { return; }
-            _bandwidth = bandwidth;
-            demod.setDeviation(_bandwidth / 2.0, _samplerate);
-            updateFilter(_lowPass, _highPass);
+            base_type::update([this, bandwidth]() {
+                if (bandwidth == _bandwidth) { return; }
+                _bandwidth = bandwidth;
+                demod.setDeviation(_bandwidth / 2.0, _samplerate);
+                updateFilter(_lowPass, _highPass);
+            });
         }
 
         void setLowPass(bool lowPass) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            updateFilter(lowPass, _highPass);
+            base_type::update([this, lowPass]() { updateFilter(lowPass, _highPass); });
         }
 
         void setHighPass(bool highPass) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            updateFilter(_lowPass, highPass);
+            base_type::update([this, highPass]() { updateFilter(_lowPass, highPass); });
         }
 
         void reset() {
@@ -87,14 +85,12 @@ namespace dsp::demod {
             if constexpr (std::is_same_v<T, float>) {
                 demod.process(count, in, out);
                 if (filtering) {
-                    std::lock_guard<std::mutex> lck(filterMtx);
                     fir.process(count, out, out);
                 }
             }
             if constexpr (std::is_same_v<T, stereo_t>) {
                 demod.process(count, in, demod.out.writeBuf);
                 if (filtering) {
-                    std::lock_guard<std::mutex> lck(filterMtx);
                     fir.process(count, demod.out.writeBuf, demod.out.writeBuf);
                 }
                 convert::MonoToStereo::process(count, demod.out.writeBuf, out);
@@ -115,8 +111,6 @@ namespace dsp::demod {
 
     private:
         void updateFilter(bool lowPass, bool highPass) {
-            std::lock_guard<std::mutex> lck(filterMtx);
-
             // Update values
             _lowPass = lowPass;
             _highPass = highPass;
@@ -158,6 +152,5 @@ namespace dsp::demod {
         Quadrature demod;
         tap<float> filterTaps;
         filter::FIR<float, float> fir;
-        std::mutex filterMtx;
     };
 }
\ No newline at end of file
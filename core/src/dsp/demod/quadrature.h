@@ -4,7 +4,13 @@
 #include "../math/hz_to_rads.h"
 #include "../math/normalize_phase.h"
 
+// Number of samples demodulated per pass, small enough for the phase differences to stay in L1 (and on the stack)
+#define QUADRATURE_CHUNK_SIZE   1024
+
 namespace dsp::demod {
+    // FM demodulator. The phase difference between consecutive samples is obtained by multiplying each
+    // sample with the conjugate of the previous one, then its angle is computed with a vectorizable
+    // polynomial atan2 whose accuracy can be traded for speed.
     class Quadrature : public Processor<complex_t, float> {
         using base_type = Processor<complex_t, float>;
     public:
@@ -26,29 +32,34 @@ namespace dsp::demod {
 
         void setDeviation(double deviation) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _invDeviation = 1.0 / deviation;
+            base_type::update([this, deviation]() { _invDeviation = 1.0 / deviation; });
         }
 
         void setDeviation(double deviation, double samplerate) {
+            setDeviation(math::hzToRads(deviation, samplerate));
+        }
+
+        // Applied by the worker between two buffers, process() reads the accuracy once per call
+        void setAccuracy(math::Atan2Accuracy accuracy) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            _invDeviation = 1.0 / math::hzToRads(deviation, samplerate);
+            base_type::update([this, accuracy]() { _accuracy = accuracy; });
         }
 
         inline int process(int count, complex_t* in, float* out) {
-            for (int i = 0; i < count; i++) {
-                float cphase = in[i].phase();
-                out[i] = math::normalizePhase(cphase - phase) * _invDeviation;
-                phase = cphase;
+            switch (_accuracy) {
+                case math::ATAN2_ACCURACY_LOW:
+                    return process<math::ATAN2_ACCURACY_LOW>(count, in, out);
+                case math::ATAN2_ACCURACY_MEDIUM:
+                    return process<math::ATAN2_ACCURACY_MEDIUM>(count, in, out);
+                default:
+                    return process<math::ATAN2_ACCURACY_HIGH>(count, in, out);
             }
-            return count;
         }
 
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            phase = 0.0f;
+            last = { 1.0f, 0.0f };
         }
 
         int run() {
@@ -63,7 +74,29 @@ namespace dsp::demod {
         }
 
     protected:
+        template <math::Atan2Accuracy ACC>
+        inline int process(int count, complex_t* in, float* out) {
+            // Local copies so that the compiler knows the output can't alias them
+            complex_t diff[QUADRATURE_CHUNK_SIZE];
+            const float invDeviation = _invDeviation;
+
+            for (int i = 0; i < count; i += QUADRATURE_CHUNK_SIZE) {
+                int n = std::min<int>(QUADRATURE_CHUNK_SIZE, count - i);
+
+                // Phase differences, the previous sample is saved before the output can overwrite it
+                diff[0] = in[i] * last.conj();
+                volk_32fc_x2_multiply_conjugate_32fc((lv_32fc_t*)&diff[1], (lv_32fc_t*)&in[i + 1], (lv_32fc_t*)&in[i], n - 1);
+                last = in[i + n - 1];
+
+                for (int j = 0; j < n; j++) {
+                    out[i + j] = math::polyAtan2<ACC>(diff[j].im, diff[j].re) * invDeviation;
+                }
+            }
+            return count;
+        }
+
         float _invDeviation;
-        float phase = 0.0f;
+        math::Atan2Accuracy _accuracy = math::ATAN2_ACCURACY_HIGH;
+        complex_t last = { 1.0f, 0.0f };
     };
 }
\ No newline at end of file
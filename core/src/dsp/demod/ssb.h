@@ -37,29 +37,26 @@ namespace dsp::demod {
 
         void setMode(Mode mode) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _mode = mode;
-            xlator.setOffset(getTranslation(), _samplerate);
-            base_type::tempStart();
+            base_type::update([this, mode]() {
+                _mode = mode;
+                xlator.setOffset(getTranslation(), _samplerate);
+            });
         }
 
         void setBandwidth(double bandwidth) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _bandwidth = bandwidth;
-            xlator.setOffset(getTranslation(), _samplerate);
-            base_type::tempStart();
+            base_type::update([this, bandwidth]() {
+                _bandwidth = bandwidth;
+                xlator.setOffset(getTranslation(), _samplerate);
+            });
         }
 
         void setSamplerate(double samplerate) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _samplerate = samplerate;
-            xlator.setOffset(getTranslation(), _samplerate);
-            base_type::tempStart();
+            base_type::update([this, samplerate]() {
+                _samplerate = samplerate;
+                xlator.setOffset(getTranslation(), _samplerate);
+            });
         }
 
         void setAGCAttack(double attack) {
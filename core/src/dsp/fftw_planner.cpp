@@ -0,0 +1,9 @@
+#include "fftw_planner.h"
+
+namespace dsp {
+    std::mutex& getFFTWPlannerMutex() {
+        // Never destroyed so that plans destroyed during static destruction can still take it
+        static std::mutex* mtx = new std::mutex;
+        return *mtx;
+    }
+}
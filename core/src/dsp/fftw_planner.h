@@ -0,0 +1,8 @@
+#pragma once
+#include <mutex>
+
+namespace dsp {
+    // The FFTW planner isn't thread safe and the waterfall plans are measured in the background, so every
+    // creation and destruction of a FFTW plan, in the core as in modules, must hold this lock
+    std::mutex& getFFTWPlannerMutex();
+}
@@ -2,35 +2,38 @@
 #include "fir.h"
 
 namespace dsp::filter {
+    // FIR filter only computing the samples kept after decimation. Real linear phase taps (as generated by
+    // taps::lowPass() and the decimation plans) are detected and folded, so that each multiply is shared by
+    // the two samples having the same tap. Outputs are computed straight from the input, only the first
+    // samples of each chunk are copied next to the history. This also works in place when decimating.
     template <class D, class T>
     class DecimatingFIR : public FIR<D, T> {
         using base_type = FIR<D, T>;
+        static constexpr int comps = sizeof(D) / sizeof(float);
     public:
         DecimatingFIR() {}
 
         DecimatingFIR(stream<D>* in, tap<T>& taps, int decimation) { init(in, taps, decimation); }
 
+        ~DecimatingFIR() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(tail);
+            buffer::free(fold);
+        }
+
         void init(stream<D>* in, tap<T>& taps, int decimation) {
             _decimation = decimation;
+            allocWork(taps);
             base_type::init(in, taps);
         }
 
-        void setTaps(tap<T>& taps) {
-            assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            offset = 0;
-            base_type::setTaps(taps);
-            base_type::tempStart();
-        }
-
         void setDecimation(int decimation) {
             assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _decimation = decimation;
-            offset = 0;
-            base_type::tempStart();
+            base_type::update([this, decimation]() {
+                _decimation = decimation;
+                offset = 0;
+            });
         }
 
         void reset() {
@@ -43,26 +46,28 @@ namespace dsp::filter {
         }
 
         inline int process(int count, const D* in, D* out) {
-            // Copy data to work buffer
-            memcpy(base_type::bufStart, in, count * sizeof(D));
+            // Short chunks, or filtering in place without decimation, go entirely through the delay buffer
+            int tapCount = base_type::_taps.size;
+            int head = 2 * tapCount;
+            if (count <= head || (in == out && _decimation < 2)) { return processBuffered(count, in, out); }
 
-            // Do convolution
+            // Copy the first samples next to the history and save the last ones before they can be overwritten
+            memcpy(base_type::bufStart, in, head * sizeof(D));
+            memcpy(tail, &in[count - (tapCount - 1)], (tapCount - 1) * sizeof(D));
+
+            // Outputs overlapping the history come from the delay buffer. When decimating, the outputs after
+            // them are written behind the samples that remain to be read.
             int outCount = 0;
+            for (; offset < head; offset += _decimation) {
+                dot(&out[outCount++], &base_type::buffer[offset]);
+            }
             for (; offset < count; offset += _decimation) {
-                if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
-                    volk_32f_x2_dot_prod_32f(&out[outCount++], &base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
-                    volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], base_type::_taps.taps, base_type::_taps.size);
-                }
-                if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
-                    volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)&out[outCount++], (lv_32fc_t*)&base_type::buffer[offset], (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
-                }
+                dot(&out[outCount++], &in[offset - (tapCount - 1)]);
             }
             offset -= count;
 
-            // Move unused data
-            memmove(base_type::buffer, &base_type::buffer[count], (base_type::_taps.size - 1) * sizeof(D));
+            // Keep the end of the chunk as history
+            memcpy(base_type::buffer, tail, (tapCount - 1) * sizeof(D));
 
             return outCount;
         }
@@ -81,8 +86,91 @@ namespace dsp::filter {
             return outCount;
         }
 
+        // Check if real taps are symmetric, allowing for rounding errors
+        static bool isSymmetric(const tap<T>& taps) {
+            if constexpr (std::is_same_v<T, float>) {
+                float max = 0.0f;
+                for (int i = 0; i < taps.size; i++) { max = std::max<float>(max, fabsf(taps.taps[i])); }
+                for (int i = 0; i < taps.size / 2; i++) {
+                    if (fabsf(taps.taps[i] - taps.taps[taps.size - 1 - i]) > max * 1e-6f) { return false; }
+                }
+                return true;
+            }
+            return false;
+        }
+
     protected:
+        void applyTaps(tap<T>& taps) {
+            offset = 0;
+            buffer::free(tail);
+            buffer::free(fold);
+            allocWork(taps);
+            base_type::applyTaps(taps);
+        }
+
+        void allocWork(tap<T>& taps) {
+            symmetric = isSymmetric(taps);
+            tail = buffer::alloc<D>(taps.size);
+            fold = buffer::alloc<D>((taps.size + 1) / 2);
+        }
+
+        // Compute one output from the window of samples ending at the current one
+        inline void dot(D* out, const D* window) {
+            if constexpr (std::is_same_v<T, float>) {
+                if (symmetric) {
+                    // Add up the samples sharing a tap, then only the first half of the taps is needed
+                    int n = base_type::_taps.size;
+                    int half = (n + 1) / 2;
+                    const float* w = (const float*)window;
+                    float* f = (float*)fold;
+                    for (int k = 0; k < n / 2; k++) {
+                        for (int c = 0; c < comps; c++) {
+                            f[k*comps + c] = w[k*comps + c] + w[(n - 1 - k)*comps + c];
+                        }
+                    }
+                    if (n & 1) { fold[half - 1] = window[half - 1]; }
+
+                    if constexpr (std::is_same_v<D, float>) {
+                        volk_32f_x2_dot_prod_32f(out, fold, base_type::_taps.taps, half);
+                    }
+                    else {
+                        volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)out, (lv_32fc_t*)fold, base_type::_taps.taps, half);
+                    }
+                    return;
+                }
+            }
+            if constexpr (std::is_same_v<D, float> && std::is_same_v<T, float>) {
+                volk_32f_x2_dot_prod_32f(out, window, base_type::_taps.taps, base_type::_taps.size);
+            }
+            if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, float>) {
+                volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)out, (lv_32fc_t*)window, base_type::_taps.taps, base_type::_taps.size);
+            }
+            if constexpr ((std::is_same_v<D, complex_t> || std::is_same_v<D, stereo_t>) && std::is_same_v<T, complex_t>) {
+                volk_32fc_x2_dot_prod_32fc((lv_32fc_t*)out, (lv_32fc_t*)window, (lv_32fc_t*)base_type::_taps.taps, base_type::_taps.size);
+            }
+        }
+
+        inline int processBuffered(int count, const D* in, D* out) {
+            // Copy data to work buffer
+            memcpy(base_type::bufStart, in, count * sizeof(D));
+
+            // Do convolution
+            int outCount = 0;
+            for (; offset < count; offset += _decimation) {
+                dot(&out[outCount++], &base_type::buffer[offset]);
+            }
+            offset -= count;
+
+            // Move unused data
+            memmove(base_type::buffer, &base_type::buffer[count], (base_type::_taps.size - 1) * sizeof(D));
+
+            return outCount;
+        }
+
         int _decimation;
         int offset = 0;
+        bool symmetric = false;
+        D* tail;
+        D* fold;
     };
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ namespace dsp::filter {
             if (!base_type::_block_init) { return; }
             base_type::stop();
             buffer::free(buffer);
+            taps::free(liveTaps);
         }
 
         virtual void init(stream<D>* in, tap<T>& taps) {
@@ -31,24 +32,20 @@ namespace dsp::filter {
         virtual void setTaps(tap<T>& taps) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-
-            int oldTC = _taps.size;
-            _taps = taps;
-
-            // Update start of buffer
-            bufStart = &buffer[_taps.size - 1];
-
-            // Move existing data to make transition seemless
-            if (_taps.size < oldTC) {
-                memmove(buffer, &buffer[oldTC - _taps.size], (_taps.size - 1) * sizeof(D));
+            if (!base_type::isLive()) {
+                applyTaps(taps);
+                taps::free(liveTaps);
+                return;
             }
-            else if (_taps.size > oldTC) {
-                memmove(&buffer[_taps.size - oldTC], buffer, (oldTC - 1) * sizeof(D));
-                buffer::clear<D>(buffer, _taps.size - oldTC);
-            }
-            
-            base_type::tempStart();
+
+            // The worker keeps the current taps until it picks up the new ones, so give it a copy the caller can't free
+            tap<T> copy = taps::alloc<T>(taps.size);
+            memcpy(copy.taps, taps.taps, taps.size * sizeof(T));
+            base_type::update([this, copy]() mutable {
+                applyTaps(copy);
+                taps::free(liveTaps);
+                liveTaps = copy;
+            });
         }
 
         virtual void reset() {
@@ -94,8 +91,28 @@ namespace dsp::filter {
         }
 
     protected:
+        virtual void applyTaps(tap<T>& taps) {
+            int oldTC = _taps.size;
+            _taps = taps;
+
+            // Update start of buffer
+            bufStart = &buffer[_taps.size - 1];
+
+            // Move existing data to make transition seemless
+            if (_taps.size < oldTC) {
+                memmove(buffer, &buffer[oldTC - _taps.size], (_taps.size - 1) * sizeof(D));
+            }
+            else if (_taps.size > oldTC) {
+                memmove(&buffer[_taps.size - oldTC], buffer, (oldTC - 1) * sizeof(D));
+                buffer::clear<D>(buffer, _taps.size - oldTC);
+            }
+        }
+
         tap<T> _taps;
         D* buffer;
         D* bufStart;
+
+        // Copy of the taps owned by the block when they were changed while it was running
+        tap<T> liveTaps;
     };
 }
\ No newline at end of file
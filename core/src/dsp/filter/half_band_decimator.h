@@ -0,0 +1,129 @@
+#pragma once
+#include "../processor.h"
+#include "../taps/tap.h"
+
+// Number of outputs computed per pass over the taps, small enough for the working set to stay in L1
+#define HALF_BAND_CHUNK_SIZE    512
+
+namespace dsp::filter {
+    // Decimation by two using half-band taps (see taps::halfBand()). Only the non-zero taps are computed
+    // and each one is applied to the sum of the two samples it is symmetric for, so an N tap filter costs
+    // about N/4 multiplies per output instead of N for a DecimatingFIR.
+    template <class D>
+    class HalfBandDecimator : public Processor<D, D> {
+        using base_type = Processor<D, D>;
+        static constexpr int comps = sizeof(D) / sizeof(float);
+    public:
+        HalfBandDecimator() {}
+
+        HalfBandDecimator(stream<D>* in, tap<float>& taps) { init(in, taps); }
+
+        ~HalfBandDecimator() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(buffer);
+            buffer::free(phase);
+            buffer::free(sideTaps);
+        }
+
+        void init(stream<D>* in, tap<float>& taps) {
+            assert(isHalfBand(taps));
+            tapCount = taps.size;
+            sideCount = (taps.size + 1) / 4;
+
+            // Keep only the non-zero taps, a half-band filter is symmetric so half of them is enough
+            int center = taps.size / 2;
+            centerTap = taps.taps[center];
+            sideTaps = buffer::alloc<float>(sideCount);
+            for (int j = 0; j < sideCount; j++) {
+                sideTaps[j] = taps.taps[center - 2*j - 1];
+            }
+
+            // Allocate and clear buffers
+            buffer = buffer::alloc<D>(STREAM_BUFFER_SIZE + 64000);
+            bufStart = &buffer[tapCount - 1];
+            buffer::clear<D>(buffer, tapCount - 1);
+            phase = buffer::alloc<D>((STREAM_BUFFER_SIZE + 64000) / 2 + tapCount);
+
+            base_type::init(in);
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            offset = 0;
+            buffer::clear<D>(buffer, tapCount - 1);
+            base_type::tempStart();
+        }
+
+        static bool isHalfBand(const tap<float>& taps) {
+            return taps.size >= 3 && (taps.size + 1) % 4 == 0;
+        }
+
+        inline int process(int count, const D* in, D* out) {
+            // Copy data to work buffer
+            memcpy(bufStart, in, count * sizeof(D));
+
+            // Outputs are computed for the samples at offset, offset+2, ..., up to the end of the input
+            int outCount = (offset < count) ? ((count - offset + 1) / 2) : 0;
+
+            // All side taps fall on the same phase of the input, gather it so that it's contiguous
+            int phaseCount = outCount + 2*sideCount - 1;
+            for (int i = 0; i < phaseCount; i++) {
+                phase[i] = buffer[offset + 2*i];
+            }
+
+            // Do convolution, tap by tap over a chunk of outputs so that the inner loops vectorize
+            const float* ph = (const float*)phase;
+            const float* mid = (const float*)&buffer[offset + tapCount / 2];
+            float* outf = (float*)out;
+            for (int start = 0; start < outCount; start += HALF_BAND_CHUNK_SIZE) {
+                int end = std::min<int>(start + HALF_BAND_CHUNK_SIZE, outCount) * comps;
+                for (int i = start * comps; i < end; i++) {
+                    int sample = i / comps;
+                    outf[i] = centerTap * mid[i + sample * comps];
+                }
+                for (int j = 0; j < sideCount; j++) {
+                    const float tap = sideTaps[j];
+                    const float* a = &ph[(sideCount - 1 - j) * comps];
+                    const float* b = &ph[(sideCount + j) * comps];
+                    for (int i = start * comps; i < end; i++) {
+                        outf[i] += tap * (a[i] + b[i]);
+                    }
+                }
+            }
+            offset += 2*outCount - count;
+
+            // Move unused data
+            memmove(buffer, &buffer[count], (tapCount - 1) * sizeof(D));
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        int tapCount;
+        int sideCount;
+        float centerTap;
+        float* sideTaps;
+
+        D* buffer;
+        D* bufStart;
+        D* phase;
+        int offset = 0;
+    };
+}
@@ -0,0 +1,242 @@
+#pragma once
+#include <math.h>
+#include <vector>
+#include <mutex>
+#include <fftw3.h>
+#include "../fftw_planner.h"
+#include "fir.h"
+
+// Below this tap count the direct convolution is always used
+#define OVERLAP_SAVE_MIN_TAPS       32
+
+// Estimated cost of one FFT butterfly relative to one multiply-accumulate of the direct form
+#define OVERLAP_SAVE_FFT_COST       1.0
+
+namespace dsp::filter {
+    // FIR filter using FFT based overlap-save fast convolution for long filters. The output is the same
+    // as the direct form (same delay, same number of samples out as in) so it can replace a filter::FIR
+    // anywhere. For each call, the direct and FFT convolutions are compared using an estimate of their
+    // cost for the current tap count and chunk size and the cheapest one is used.
+    template <class D, class T>
+    class OverlapSaveFIR : public FIR<D, T> {
+        using base_type = FIR<D, T>;
+    public:
+        // FFT plans and frequency domain taps for one set of taps
+        struct Kernel {
+            int fftSize = 0;
+            int blockSize = 0;
+            fftwf_complex* timeBuf = NULL;
+            fftwf_complex* freqBuf = NULL;
+            fftwf_complex* freqTaps = NULL;
+            fftwf_plan forwardPlan;
+            fftwf_plan backwardPlan;
+        };
+
+        // Copy of a set of taps along with their kernel, see prepareTaps()
+        struct Prepared {
+            tap<T> taps;
+            Kernel kern;
+        };
+
+        OverlapSaveFIR() {}
+
+        OverlapSaveFIR(stream<D>* in, tap<T>& taps) { init(in, taps); }
+
+        ~OverlapSaveFIR() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            freeKernel(kern);
+            freeRetired();
+        }
+
+        void init(stream<D>* in, tap<T>& taps) {
+            base_type::init(in, taps);
+            kern = makeKernel(taps);
+        }
+
+        // The kernel is planned on the calling thread, the worker only swaps it in
+        void setTaps(tap<T>& taps) override {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            freeRetired();
+            Prepared p = prepareTaps(taps);
+            base_type::update([this, p]() mutable { applyPrepared(p); });
+        }
+
+        // Copy the taps and plan their kernel. Can be called from any thread, which lets the owner of a sub-block
+        // do the expensive part before handing the result to its worker with applyPrepared().
+        Prepared prepareTaps(tap<T>& taps) {
+            Prepared p;
+            p.taps = taps::alloc<T>(taps.size);
+            memcpy(p.taps.taps, taps.taps, taps.size * sizeof(T));
+            p.kern = makeKernel(p.taps);
+            return p;
+        }
+
+        // Switch to prepared taps, only called by the thread processing the samples. The previous kernel is kept
+        // until freeRetired() is called since destroying its plans can wait on the FFTW planner.
+        void applyPrepared(Prepared& p) {
+            base_type::applyTaps(p.taps);
+            taps::free(base_type::liveTaps);
+            base_type::liveTaps = p.taps;
+            {
+                std::lock_guard<std::mutex> lck(retiredMtx);
+                retired.push_back(kern);
+            }
+            kern = p.kern;
+        }
+
+        // Free the kernels replaced by applyPrepared(), must not be called by the thread processing the samples
+        void freeRetired() {
+            std::vector<Kernel> list;
+            {
+                std::lock_guard<std::mutex> lck(retiredMtx);
+                list.swap(retired);
+            }
+            for (auto& k : list) { freeKernel(k); }
+        }
+
+        // Returns true if a chunk of the given size would be filtered using the FFT
+        inline bool usesFFT(int count) {
+            if (!kern.fftSize) { return false; }
+
+            // Real data is processed two blocks at a time, using the real and imaginary parts
+            int lanes = std::is_same_v<D, float> ? 2 : 1;
+            int blocks = (count + (kern.blockSize * lanes) - 1) / (kern.blockSize * lanes);
+
+            // Two FFTs, the product with the kernel and the copies per block vs one MAC per tap per sample
+            double fftCost = (double)blocks * ((2.0 * OVERLAP_SAVE_FFT_COST * kern.fftSize * log2(kern.fftSize)) + (3.0 * kern.fftSize));
+            double directCost = (double)count * (double)base_type::_taps.size;
+            return fftCost < directCost;
+        }
+
+        inline int process(int count, const D* in, D* out) {
+            if (!usesFFT(count)) { return base_type::process(count, in, out); }
+
+            // Copy data to work buffer
+            memcpy(base_type::bufStart, in, count * sizeof(D));
+
+            int tapCount = base_type::_taps.size;
+            int fftSize = kern.fftSize;
+            int blockSize = kern.blockSize;
+            complex_t* tbuf = (complex_t*)kern.timeBuf;
+            for (int i = 0; i < count;) {
+                // Load the blocks with their history and zero pad the rest.
+                // Zero padding only affects outputs past the end of the block so partial blocks are fine.
+                buffer::clear(tbuf, fftSize);
+                int n0 = std::min<int>(blockSize, count - i);
+                int n1 = 0;
+                if constexpr (std::is_same_v<D, float>) {
+                    n1 = std::min<int>(blockSize, count - i - n0);
+                    const float* b0 = &base_type::buffer[i];
+                    for (int j = 0; j < n0 + tapCount - 1; j++) { tbuf[j].re = b0[j]; }
+                    if (n1) {
+                        const float* b1 = &base_type::buffer[i + n0];
+                        for (int j = 0; j < n1 + tapCount - 1; j++) { tbuf[j].im = b1[j]; }
+                    }
+                }
+                else {
+                    memcpy(tbuf, &base_type::buffer[i], (n0 + tapCount - 1) * sizeof(D));
+                }
+
+                // Multiply in the frequency domain
+                fftwf_execute(kern.forwardPlan);
+                volk_32fc_x2_multiply_32fc((lv_32fc_t*)kern.freqBuf, (lv_32fc_t*)kern.freqBuf, (lv_32fc_t*)kern.freqTaps, fftSize);
+                fftwf_execute(kern.backwardPlan);
+
+                // The first tapCount-1 samples are circular convolution garbage, the rest is the output
+                const complex_t* res = &tbuf[tapCount - 1];
+                if constexpr (std::is_same_v<D, float>) {
+                    for (int j = 0; j < n0; j++) { out[i + j] = res[j].re; }
+                    for (int j = 0; j < n1; j++) { out[i + n0 + j] = res[j].im; }
+                }
+                else {
+                    memcpy(&out[i], res, n0 * sizeof(D));
+                }
+                i += n0 + n1;
+            }
+
+            // Move unused data
+            memmove(base_type::buffer, &base_type::buffer[count], (tapCount - 1) * sizeof(D));
+
+            return count;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            base_type::_in->flush();
+            if (!base_type::out.swap(count)) { return -1; }
+            return count;
+        }
+
+    protected:
+        static Kernel makeKernel(tap<T>& taps) {
+            Kernel k;
+            int tapCount = taps.size;
+
+            // Real data with complex taps can't be packed in the real and imaginary parts, and short filters are better off direct
+            if (tapCount < OVERLAP_SAVE_MIN_TAPS) { return k; }
+            if constexpr (std::is_same_v<D, float> && !std::is_same_v<T, float>) { return k; }
+
+            // Pick the FFT size with the lowest cost per output sample, at least twice the tap count
+            int minSize = 1;
+            while (minSize < 2 * tapCount) { minSize <<= 1; }
+            double bestCost = INFINITY;
+            for (int size = minSize; size <= minSize * 8; size <<= 1) {
+                double cost = ((2.0 * OVERLAP_SAVE_FFT_COST * size * log2(size)) + (3.0 * size)) / (double)(size - tapCount + 1);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    k.fftSize = size;
+                }
+            }
+            k.blockSize = k.fftSize - tapCount + 1;
+
+            k.timeBuf = (fftwf_complex*)fftwf_malloc(k.fftSize * sizeof(fftwf_complex));
+            k.freqBuf = (fftwf_complex*)fftwf_malloc(k.fftSize * sizeof(fftwf_complex));
+            k.freqTaps = (fftwf_complex*)fftwf_malloc(k.fftSize * sizeof(fftwf_complex));
+            {
+                std::lock_guard<std::mutex> lck(getFFTWPlannerMutex());
+                k.forwardPlan = fftwf_plan_dft_1d(k.fftSize, k.timeBuf, k.freqBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+                k.backwardPlan = fftwf_plan_dft_1d(k.fftSize, k.freqBuf, k.timeBuf, FFTW_BACKWARD, FFTW_ESTIMATE);
+            }
+
+            // The direct form computes a dot product with the taps, so the convolution kernel is the reversed taps.
+            // The 1/N scaling of the inverse FFT is folded into the kernel.
+            complex_t* tbuf = (complex_t*)k.timeBuf;
+            buffer::clear(tbuf, k.fftSize);
+            float scale = 1.0f / (float)k.fftSize;
+            for (int i = 0; i < tapCount; i++) {
+                if constexpr (std::is_same_v<T, float>) {
+                    tbuf[i] = { taps.taps[tapCount - 1 - i] * scale, 0.0f };
+                }
+                else {
+                    tbuf[i] = taps.taps[tapCount - 1 - i] * scale;
+                }
+            }
+            fftwf_execute(k.forwardPlan);
+            memcpy(k.freqTaps, k.freqBuf, k.fftSize * sizeof(fftwf_complex));
+            return k;
+        }
+
+        static void freeKernel(Kernel& k) {
+            if (!k.fftSize) { return; }
+            {
+                std::lock_guard<std::mutex> lck(getFFTWPlannerMutex());
+                fftwf_destroy_plan(k.forwardPlan);
+                fftwf_destroy_plan(k.backwardPlan);
+            }
+            fftwf_free(k.timeBuf);
+            fftwf_free(k.freqBuf);
+            fftwf_free(k.freqTaps);
+            k.fftSize = 0;
+        }
+
+        Kernel kern;
+        std::mutex retiredMtx;
+        std::vector<Kernel> retired;
+    };
+}
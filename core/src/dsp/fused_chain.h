@@ -0,0 +1,308 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <typeindex>
+#include <type_traits>
+#include <stdexcept>
+#include "processor.h"
+
+namespace dsp {
+    // Runs a linear sequence of processors back-to-back in a single worker thread. Instead of each
+    // block having its own thread and output stream, the process() function of every enabled stage
+    // is called in turn on a pair of shared scratch buffers, and only the final result is written
+    // to the output stream. Stages must be initialized with a NULL input and must not be started.
+    // Stages can be enabled and disabled like in dsp::chain as long as they don't change the type.
+    // Like dsp::chain, a chain with no enabled stage hands its input straight to the consumer and has
+    // no worker, so consumers must use getOutput() and follow the output change callbacks.
+    // Since stages aren't started their setters apply immediately, so they must be called through
+    // updateBlock() while the chain is running.
+    template <class I, class O>
+    class FusedChain : public Processor<I, O> {
+        using base_type = Processor<I, O>;
+    public:
+        FusedChain() {}
+
+        FusedChain(stream<I>* in) { init(in); }
+
+        ~FusedChain() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(scratch[0]);
+            buffer::free(scratch[1]);
+        }
+
+        void init(stream<I>* in) {
+            // Scratch buffers are (re)allocated as stages are added, depending on their sample size
+            scratchSampleSize = std::max<int>(sizeof(I), sizeof(O));
+            scratch[0] = buffer::alloc<uint8_t>(STREAM_BUFFER_SIZE * scratchSampleSize);
+            scratch[1] = buffer::alloc<uint8_t>(STREAM_BUFFER_SIZE * scratchSampleSize);
+            base_type::init(in);
+        }
+
+        template <class B>
+        void addBlock(B* block, bool enabled) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check if block is already part of the chain
+            if (findStage(block) != stages.end()) {
+                throw std::runtime_error("[FusedChain] Tried to add a block that is already part of the chain");
+            }
+
+            // Deduce the I/O types of the block from its Processor base class
+            using BI = typename decltype(ioTypes(block))::first_type;
+            using BO = typename decltype(ioTypes(block))::second_type;
+
+            // Check that the block can be connected to the end of the chain
+            std::type_index prevType = stages.empty() ? std::type_index(typeid(I)) : stages.back().outType;
+            if (prevType != std::type_index(typeid(BI))) {
+                throw std::runtime_error("[FusedChain] Tried to add a block whose input type doesn't match the output type of the chain");
+            }
+
+            Stage stage = {
+                block,
+                [block](int count, const void* in, void* out) { return block->process(count, (BI*)in, (BO*)out); },
+                std::type_index(typeid(BI)),
+                std::type_index(typeid(BO)),
+                false
+            };
+
+            base_type::tempStop();
+
+            // Grow scratch buffers if the new block uses larger samples
+            if (std::max<int>(sizeof(BI), sizeof(BO)) > scratchSampleSize) {
+                scratchSampleSize = std::max<int>(sizeof(BI), sizeof(BO));
+                for (auto& buf : scratch) {
+                    buffer::free(buf);
+                    buf = buffer::alloc<uint8_t>(STREAM_BUFFER_SIZE * scratchSampleSize);
+                }
+            }
+            stages.push_back(stage);
+
+            base_type::tempStart();
+
+            // Nothing consumes the output yet, it's picked up with getOutput() once the chain is built
+            if (enabled) { enableBlock(block, [](stream<O>* out) {}); }
+        }
+
+        template <typename Func>
+        void removeBlock(generic_block* block, Func onOutputChange) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check if block is part of the chain
+            auto it = findStage(block);
+            if (it == stages.end()) {
+                throw std::runtime_error("[FusedChain] Tried to remove a block that is not part of the chain");
+            }
+
+            // Removing a type converting block would break the chain
+            if (it->inType != it->outType) {
+                throw std::runtime_error("[FusedChain] Tried to remove a block that changes the sample type");
+            }
+
+            // Disabling first lets the consumer follow the output if this was the last enabled stage
+            disableBlock(block, onOutputChange);
+            base_type::tempStop();
+            stages.erase(findStage(block));
+            base_type::tempStart();
+        }
+
+        template <typename Func>
+        void setInput(stream<I>* in, Func onOutputChange) {
+            base_type::setInput(in);
+            if (isBypassed()) { onOutputChange(getOutput()); }
+        }
+
+        template <typename Func>
+        void enableBlock(generic_block* block, Func onOutputChange) {
+            setBlockEnabled(block, true, onOutputChange);
+        }
+
+        template <typename Func>
+        void disableBlock(generic_block* block, Func onOutputChange) {
+            setBlockEnabled(block, false, onOutputChange);
+        }
+
+        template <typename Func>
+        void enableAllBlocks(Func onOutputChange) {
+            for (auto& stage : stages) {
+                enableBlock(stage.block, onOutputChange);
+            }
+        }
+
+        template <typename Func>
+        void disableAllBlocks(Func onOutputChange) {
+            for (auto& stage : stages) {
+                if (stage.inType != stage.outType) { continue; }
+                disableBlock(stage.block, onOutputChange);
+            }
+        }
+
+        template <typename Func>
+        void setBlockEnabled(generic_block* block, bool enabled, Func onOutputChange) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+
+            // Check that the block is part of the chain
+            auto it = findStage(block);
+            if (it == stages.end()) {
+                throw std::runtime_error("[FusedChain] Tried to enable or disable a block that isn't part of the chain");
+            }
+
+            // Bypassing a type converting block would break the chain
+            if (!enabled && it->inType != it->outType) {
+                throw std::runtime_error("[FusedChain] Tried to disable a block that changes the sample type");
+            }
+
+            // Stage states are only read by the worker, so swapping them at a chunk boundary is enough
+            if (it->enabled == enabled) { return; }
+            bool willBypass = !enabled && bypassedWithout(it);
+            if (isBypassed() == willBypass) {
+                std::lock_guard<std::mutex> lck2(stageMtx);
+                it->enabled = enabled;
+                return;
+            }
+
+            // Going from or to bypass starts or stops the worker, the consumer is switched while it's stopped
+            base_type::tempStop();
+            {
+                std::lock_guard<std::mutex> lck2(stageMtx);
+                it->enabled = enabled;
+            }
+            onOutputChange(getOutput());
+            base_type::tempStart();
+        }
+
+        // Stream to consume, the input itself if no stage is enabled
+        stream<O>* getOutput() {
+            if constexpr (std::is_same_v<I, O>) {
+                if (isBypassed()) { return base_type::_in; }
+            }
+            return &this->out;
+        }
+
+        // Run 'fn', usually setters of the stage, between two chunks instead of while the worker is processing one
+        void updateBlock(generic_block* block, std::function<void()> fn) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            if (findStage(block) == stages.end()) {
+                throw std::runtime_error("[FusedChain] Tried to update a block that isn't part of the chain");
+            }
+            std::lock_guard<std::mutex> lck2(stageMtx);
+            fn();
+        }
+
+        bool isBlockEnabled(generic_block* block) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            auto it = findStage(block);
+            return (it != stages.end()) ? it->enabled : false;
+        }
+
+        inline int process(int count, const I* in, O* out) {
+            std::lock_guard<std::mutex> lck(stageMtx);
+
+            // Find the last enabled stage, it will write directly to the output
+            int last = -1;
+            for (int i = 0; i < stages.size(); i++) {
+                if (stages[i].enabled) { last = i; }
+            }
+
+            // If no stage is enabled, just pass the samples through
+            if (last < 0) {
+                if constexpr (std::is_same_v<I, O>) {
+                    memcpy(out, in, count * sizeof(I));
+                    return count;
+                }
+                return 0;
+            }
+
+            // Ping-pong between the scratch buffers
+            const void* data = in;
+            int sbuf = 0;
+            for (int i = 0; i <= last && count > 0; i++) {
+                auto& stage = stages[i];
+                if (!stage.enabled) { continue; }
+                void* dst = (i == last) ? (void*)out : (void*)scratch[sbuf];
+                count = stage.process(count, data, dst);
+                data = dst;
+                sbuf ^= 1;
+            }
+            return count;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        struct Stage {
+            generic_block* block;
+            std::function<int(int, const void*, void*)> process;
+            std::type_index inType;
+            std::type_index outType;
+            bool enabled;
+        };
+
+        template <class BI, class BO>
+        static std::pair<BI, BO> ioTypes(Processor<BI, BO>* block);
+
+        typename std::vector<Stage>::iterator findStage(generic_block* block) {
+            return std::find_if(stages.begin(), stages.end(), [block](const Stage& s) { return s.block == block; });
+        }
+
+        // True if the input can be handed to the consumer as is
+        bool isBypassed() {
+            if constexpr (!std::is_same_v<I, O>) { return false; }
+            for (auto& stage : stages) {
+                if (stage.enabled) { return false; }
+            }
+            return true;
+        }
+
+        bool bypassedWithout(typename std::vector<Stage>::iterator skip) {
+            if constexpr (!std::is_same_v<I, O>) { return false; }
+            for (auto it = stages.begin(); it != stages.end(); it++) {
+                if (it != skip && it->enabled) { return false; }
+            }
+            return true;
+        }
+
+        void doStart() {
+            // Make sure the full chain actually produces the output type
+            std::type_index lastType = stages.empty() ? std::type_index(typeid(I)) : stages.back().outType;
+            if (lastType != std::type_index(typeid(O))) {
+                throw std::runtime_error("[FusedChain] Output type of the last block doesn't match the output type of the chain");
+            }
+
+            // No worker needed while the consumer reads the input directly
+            if (isBypassed()) { return; }
+            workerActive = true;
+            base_type::doStart();
+        }
+
+        void doStop() {
+            // The input mustn't be stopped while the consumer reads it directly
+            if (!workerActive) { return; }
+            base_type::doStop();
+            workerActive = false;
+        }
+
+        std::vector<Stage> stages;
+        std::mutex stageMtx;
+        bool workerActive = false;
+        uint8_t* scratch[2];
+        int scratchSampleSize;
+    };
+}
@@ -2,6 +2,10 @@
 #include "../processor.h"
 
 namespace dsp::loop {
+    // Automatic gain control. When the output would clip, the amplitude estimate jumps to the peak of the
+    // input over the lookahead window, found with a sliding window maximum (monotonic deque) so that impulsive
+    // signals don't cost more than regular ones. The gains are computed first, then applied in a single
+    // vectorized pass.
     template <class T>
     class AGC : public Processor<T, T> {
         using base_type = Processor<T, T>;
@@ -10,6 +14,13 @@ namespace dsp::loop {
 
         AGC(stream<T>* in, double setPoint, double attack, double decay, double maxGain, double maxOutputAmp, double initGain = 1.0) { init(in, setPoint, attack, decay, maxGain, maxOutputAmp, initGain); }
 
+        ~AGC() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(amps);
+            buffer::free(peakIds);
+        }
+
         void init(stream<T>* in, double setPoint, double attack, double decay, double maxGain, double maxOutputAmp, double initGain = 1.0) {
             _setPoint = setPoint;
             _attack = attack;
@@ -20,6 +31,8 @@ namespace dsp::loop {
             _maxOutputAmp = maxOutputAmp;
             _initGain = initGain;
             amp = _setPoint / _initGain;
+            amps = buffer::alloc<float>(STREAM_BUFFER_SIZE);
+            peakIds = buffer::alloc<int>(STREAM_BUFFER_SIZE);
             base_type::init(in);
         }
 
@@ -61,6 +74,13 @@ namespace dsp::loop {
             _initGain = initGain;
         }
 
+        // Number of samples looked ahead for the peak when clipping. Zero looks up to the end of the buffer.
+        void setLookahead(int lookahead) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            _lookahead = lookahead;
+        }
+
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
@@ -68,17 +88,23 @@ namespace dsp::loop {
         }
 
         inline int process(int count, T* in, T* out) {
-            for (int i = 0; i < count; i++) {
-                // Get signal amplitude
-                float inAmp, gain;
-                if constexpr (std::is_same_v<T, complex_t>) {
-                    inAmp = in[i].amplitude();
-                }
-                if constexpr (std::is_same_v<T, float>) {
-                    inAmp = fabsf(in[i]);
-                }
+            // Get signal amplitude
+            if constexpr (std::is_same_v<T, complex_t>) {
+                volk_32fc_magnitude_32f(amps, (lv_32fc_t*)in, count);
+            }
+            if constexpr (std::is_same_v<T, float>) {
+                for (int i = 0; i < count; i++) { amps[i] = fabsf(in[i]); }
+            }
 
+            // Compute the gains, replacing the amplitudes as they aren't needed anymore
+            int lookahead = (_lookahead > 0) ? _lookahead : count;
+            int head = 0;
+            int tail = 0;
+            int next = 0;
+            for (int i = 0; i < count; i++) {
                 // Update average amplitude
+                float inAmp = amps[i];
+                float gain;
                 if (inAmp != 0.0f) {
                     amp = (inAmp > amp) ? ((amp * _invAttack) + (inAmp * _attack)) : ((amp * _invDecay) + (inAmp * _decay));
                     gain = std::min<float>(_setPoint / amp, _maxGain);
@@ -87,24 +113,30 @@ namespace dsp::loop {
                     gain = 1.0f;
                 }
 
-                // If clipping is detected look ahead and correct
+                // Slide the peak window to [i, i + lookahead). The deque only keeps samples that are
+                // larger than all the ones after them, so its front is the peak of the window.
+                if (head < tail && peakIds[head] < i) { head++; }
+                int end = std::min<int>(i + lookahead, count);
+                for (; next < end; next++) {
+                    while (tail > head && amps[peakIds[tail - 1]] <= amps[next]) { tail--; }
+                    peakIds[tail++] = next;
+                }
+
+                // If clipping is detected use the peak of the window instead
                 if (inAmp*gain > _maxOutputAmp) {
-                    float maxAmp = 0;
-                    for (int j = i; j < count; j++) {
-                        if constexpr (std::is_same_v<T, complex_t>) {
-                            inAmp = in[j].amplitude();
-                        }
-                        if constexpr (std::is_same_v<T, float>) {
-                            inAmp = fabsf(in[j]);
-                        }
-                        if (inAmp > maxAmp) { maxAmp = inAmp; }
-                    }
-                    amp = maxAmp;
+                    amp = amps[peakIds[head]];
                     gain = std::min<float>(_setPoint / amp, _maxGain);
                 }
-                
-                // Scale output by gain
-                out[i] = in[i] * gain;
+
+                amps[i] = gain;
+            }
+
+            // Scale output by gain
+            if constexpr (std::is_same_v<T, complex_t>) {
+                volk_32fc_32f_multiply_32fc((lv_32fc_t*)out, (lv_32fc_t*)in, amps, count);
+            }
+            if constexpr (std::is_same_v<T, float>) {
+                volk_32f_x2_multiply_32f(out, in, amps, count);
             }
             return count;
         }
@@ -130,7 +162,11 @@ namespace dsp::loop {
         float _maxOutputAmp;
         float _initGain;
 
+        int _lookahead = 0;
+
         float amp = 1.0;
+        float* amps;
+        int* peakIds;
 
     };
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <math.h>
+#include <float.h>
 #include "constants.h"
 
 #define FAST_ATAN2_COEF1 FL_M_PI / 4.0f
@@ -23,4 +24,45 @@ namespace dsp::math {
         }
         return angle;
     }
-}
\ No newline at end of file
+
+    enum Atan2Accuracy {
+        ATAN2_ACCURACY_LOW,     // Max error of 6e-4 rad
+        ATAN2_ACCURACY_MEDIUM,  // Max error of 2e-6 rad
+        ATAN2_ACCURACY_HIGH     // Max error of 4e-8 rad, as good as atan2f()
+    };
+
+    // Minimax polynomial approximation of atan(z) for z in [0, 1]
+    template <Atan2Accuracy ACC>
+    inline float atanPoly(float z) {
+        float z2 = z * z;
+        if constexpr (ACC == ATAN2_ACCURACY_LOW) {
+            return z * (0.995357440f + z2 * (-0.288687301f + z2 * 0.079335978f));
+        }
+        if constexpr (ACC == ATAN2_ACCURACY_MEDIUM) {
+            return z * (0.999977217f + z2 * (-0.332622781f + z2 * (0.193540067f + z2 * (-0.116425665f + z2 * (0.052646425f + z2 * -0.011718759f)))));
+        }
+        if constexpr (ACC == ATAN2_ACCURACY_HIGH) {
+            return z * (9.999993357e-01f + z2 * (-3.332986143e-01f + z2 * (1.994657256e-01f + z2 * (-1.390866203e-01f + z2 * (9.642275308e-02f + z2 * (-5.591332569e-02f + z2 * (2.186360767e-02f + z2 * -4.054735876e-03f)))))));
+        }
+    }
+
+    // Branchless atan2(y, x) so that loops using it can be vectorized. Returns 0 for (0, 0).
+    template <Atan2Accuracy ACC>
+    inline float polyAtan2(float y, float x) {
+        float ax = fabsf(x);
+        float ay = fabsf(y);
+        bool swap = (ax < ay);
+        float mn = swap ? ax : ay;
+        float mx = swap ? ay : ax;
+        float angle = atanPoly<ACC>(mn / ((mx > FLT_MIN) ? mx : FLT_MIN));
+
+        // Unfold the octant. Only constants are selected, otherwise the compiler
+        // turns the selects into branches and the loop doesn't vectorize.
+        float off1 = swap ? (FL_M_PI / 2.0f) : 0.0f;
+        float sign1 = swap ? -1.0f : 1.0f;
+        float off2 = (x < 0.0f) ? FL_M_PI : 0.0f;
+        float sign2 = (x < 0.0f) ? -1.0f : 1.0f;
+        float sign3 = (y < 0.0f) ? -1.0f : 1.0f;
+        return sign3 * (off2 + sign2 * (off1 + sign1 * angle));
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <math.h>
+#include <algorithm>
+#include <volk/volk.h>
+
+// Below this number of bins, a scalar loop is faster than calling into VOLK
+#define SPECTRUM_REDUCE_VOLK_MIN    32
+
+namespace dsp::math {
+    // Maximum of a range of bins. Large ranges use the VOLK max search, which is dispatched to the best SIMD kernel of the CPU.
+    inline float rangeMax(const float* in, int count) {
+        if (count <= 0) { return -INFINITY; }
+        if (count >= SPECTRUM_REDUCE_VOLK_MIN) {
+            uint32_t id;
+            volk_32f_index_max_32u(&id, in, count);
+            return in[id];
+        }
+        float max = in[0];
+        for (int i = 1; i < count; i++) {
+            max = std::max<float>(max, in[i]);
+        }
+        return max;
+    }
+
+    // Minimum and maximum of a range of bins. Split across independent lanes so that the compiler vectorizes it.
+    inline void rangeMinMax(const float* in, int count, float& min, float& max) {
+        min = INFINITY;
+        max = -INFINITY;
+        if (count <= 0) { return; }
+
+        constexpr int lanes = 8;
+        float mins[lanes], maxs[lanes];
+        for (int k = 0; k < lanes; k++) {
+            mins[k] = in[0];
+            maxs[k] = in[0];
+        }
+        int i = 0;
+        for (; i + lanes <= count; i += lanes) {
+            for (int k = 0; k < lanes; k++) {
+                mins[k] = std::min<float>(mins[k], in[i + k]);
+                maxs[k] = std::max<float>(maxs[k], in[i + k]);
+            }
+        }
+        for (; i < count; i++) {
+            mins[0] = std::min<float>(mins[0], in[i]);
+            maxs[0] = std::max<float>(maxs[0], in[i]);
+        }
+        for (int k = 0; k < lanes; k++) {
+            min = std::min<float>(min, mins[k]);
+            max = std::max<float>(max, maxs[k]);
+        }
+    }
+
+    // Reduce 'width' bins starting at 'offset' to 'outSize' output bins, each one being the maximum of
+    // the ceil(width / outSize) bins starting at its position. If there are fewer input than output
+    // bins, input bins are repeated.
+    inline void maxPool(const float* in, int inSize, int offset, int width, float* out, int outSize) {
+        double factor = (double)width / (double)outSize;
+        int poolSize = ceil(factor);
+        double id = offset;
+        for (int i = 0; i < outSize; i++) {
+            int start = (int)id;
+            out[i] = rangeMax(&in[start], std::min<int>(poolSize, inSize - start));
+            id += factor;
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include "../processor.h"
+#include "../taps/tap.h"
+#include "polyphase_bank.h"
+
+// Number of phases of the filter bank, outputs falling between two phases are linearly interpolated
+#define ARBITRARY_RESAMP_PHASES     64
+
+namespace dsp::multirate {
+    // Resampler for any ratio, including irrational ones. Unlike PolyphaseResampler, the size of the filter
+    // bank doesn't depend on the ratio. The taps must be designed for a samplerate of ARBITRARY_RESAMP_PHASES
+    // times the input samplerate, with a gain of ARBITRARY_RESAMP_PHASES.
+    template<class T>
+    class ArbitraryResampler : public Processor<T, T> {
+        using base_type = Processor<T, T>;
+    public:
+        ArbitraryResampler() {}
+
+        ArbitraryResampler(stream<T>* in, double ratio, tap<float>& taps) { init(in, ratio, taps); }
+
+        ~ArbitraryResampler() {
+            if (!base_type::_block_init) { return; }
+            base_type::stop();
+            buffer::free(buffer);
+            buffer::free(bank);
+        }
+
+        void init(stream<T>* in, double ratio, tap<float>& taps) {
+            _ratio = ratio;
+            step = 1.0 / ratio;
+
+            // Build filter bank
+            buildBank(taps);
+
+            // Allocate delay buffer
+            buffer = buffer::alloc<T>(STREAM_BUFFER_SIZE + 64000);
+            bufStart = &buffer[tapsPerPhase - 1];
+            buffer::clear<T>(buffer, tapsPerPhase - 1);
+
+            base_type::init(in);
+        }
+
+        void setRatio(double ratio, tap<float>& taps) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+
+            // Update settings
+            _ratio = ratio;
+            step = 1.0 / ratio;
+
+            // Re-generate filter bank
+            buffer::free(bank);
+            buildBank(taps);
+
+            // Reset buffer
+            bufStart = &buffer[tapsPerPhase - 1];
+            reset();
+
+            base_type::tempStart();
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            buffer::clear<T>(buffer, tapsPerPhase - 1);
+            frac = 0.0;
+            offset = 0;
+            base_type::tempStart();
+        }
+
+        inline int process(int count, const T* in, T* out) {
+            int outCount = 0;
+
+            // Copy input to buffer
+            memcpy(bufStart, in, count * sizeof(T));
+
+            while (offset < count) {
+                // Find the two phases surrounding the output
+                float phase = frac * (double)ARBITRARY_RESAMP_PHASES;
+                int id = (int)phase;
+                float mu = phase - (float)id;
+
+                // Do both convolutions and interpolate between them
+                T a, b;
+                dot(&a, &buffer[offset], &bank[id * tapsPerPhase]);
+                dot(&b, &buffer[offset], &bank[(id + 1) * tapsPerPhase]);
+                out[outCount++] = a * (1.0f - mu) + b * mu;
+
+                // Advance to the next output
+                frac += step;
+                int adv = (int)frac;
+                offset += adv;
+                frac -= (double)adv;
+            }
+            offset -= count;
+
+            // Move delay
+            memmove(buffer, &buffer[count], (tapsPerPhase - 1) * sizeof(T));
+
+            return outCount;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        void buildBank(tap<float>& taps) {
+            // Each phase gets one more tap so that the phase after the last one can be the
+            // first one delayed by a sample, which keeps interpolation within the same window
+            PolyphaseBank<float> pb = buildPolyphaseBank(ARBITRARY_RESAMP_PHASES, taps);
+            tapsPerPhase = pb.tapsPerPhase + 1;
+            bank = buffer::alloc<float>((ARBITRARY_RESAMP_PHASES + 1) * tapsPerPhase);
+            buffer::clear<float>(bank, (ARBITRARY_RESAMP_PHASES + 1) * tapsPerPhase);
+            for (int i = 0; i < ARBITRARY_RESAMP_PHASES; i++) {
+                memcpy(&bank[i * tapsPerPhase], pb.phases[i], pb.tapsPerPhase * sizeof(float));
+            }
+            memcpy(&bank[ARBITRARY_RESAMP_PHASES * tapsPerPhase + 1], pb.phases[0], pb.tapsPerPhase * sizeof(float));
+            freePolyphaseBank(pb);
+        }
+
+        inline void dot(T* out, const T* in, const float* taps) {
+            if constexpr (std::is_same_v<T, float>) {
+                volk_32f_x2_dot_prod_32f(out, in, taps, tapsPerPhase);
+            }
+            if constexpr (std::is_same_v<T, complex_t> || std::is_same_v<T, stereo_t>) {
+                volk_32fc_32f_dot_prod_32fc((lv_32fc_t*)out, (lv_32fc_t*)in, taps, tapsPerPhase);
+            }
+        }
+
+        double _ratio;
+        double step;
+        float* bank;
+        int tapsPerPhase;
+        double frac = 0.0;
+        int offset = 0;
+        T* buffer;
+        T* bufStart;
+    };
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include "../processor.h"
+#include "../taps/tap.h"
+
+// Maximum number of integrator and comb sections
+#define CIC_MAX_ORDER       6
+
+// Fractional bits of the fixed point input and magnitude at which the input is clipped
+#define CIC_FRAC_BITS       24
+#define CIC_MAX_INPUT       16.0f
+
+namespace dsp::multirate {
+    // Cascaded integrator-comb decimator. It needs no multiplies, which makes it the cheapest first stage
+    // for very large decimation ratios. The sections run on wrapping 64bit fixed point so that the
+    // integrators can't drift. The gain is normalized to one, the passband has the droop of a sinc^order
+    // which compensate() can correct in the next FIR stage.
+    template <class T>
+    class CICDecimator : public Processor<T, T> {
+        using base_type = Processor<T, T>;
+        static constexpr int comps = sizeof(T) / sizeof(float);
+    public:
+        CICDecimator() {}
+
+        CICDecimator(stream<T>* in, int decimation, int order) { init(in, decimation, order); }
+
+        void init(stream<T>* in, int decimation, int order) {
+            assert(order > 0 && order <= CIC_MAX_ORDER);
+            _decimation = decimation;
+            _order = order;
+            configure();
+            base_type::init(in);
+        }
+
+        void setDecimation(int decimation) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            _decimation = decimation;
+            configure();
+            base_type::tempStart();
+        }
+
+        void reset() {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            clearState();
+            base_type::tempStart();
+        }
+
+        // Convolve the taps of a filter running at the output rate of the CIC with the [-a, 1+2a, -a]
+        // corrector, a = order/24, which cancels the droop of the CIC to the second order
+        static tap<float> compensate(const float* taps, int count, int order) {
+            double a = (double)order / 24.0;
+            const double corr[3] = { -a, 1.0 + 2.0*a, -a };
+            tap<float> out = taps::alloc<float>(count + 2);
+            for (int i = 0; i < count + 2; i++) {
+                double sum = 0.0;
+                for (int k = 0; k < 3; k++) {
+                    int id = i - k;
+                    if (id >= 0 && id < count) { sum += corr[k] * taps[id]; }
+                }
+                out.taps[i] = sum;
+            }
+            return out;
+        }
+
+        inline int process(int count, const T* in, T* out) {
+            switch (_order) {
+                case 1: return processOrder<1>(count, in, out);
+                case 2: return processOrder<2>(count, in, out);
+                case 3: return processOrder<3>(count, in, out);
+                case 4: return processOrder<4>(count, in, out);
+                case 5: return processOrder<5>(count, in, out);
+                case 6: return processOrder<6>(count, in, out);
+            }
+            return 0;
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            int outCount = process(count, base_type::_in->readBuf, base_type::out.writeBuf);
+
+            // Swap if some data was generated
+            base_type::_in->flush();
+            if (outCount) {
+                if (!base_type::out.swap(outCount)) { return -1; }
+            }
+            return outCount;
+        }
+
+    protected:
+        // The order is a template parameter so that the state can stay in registers. Each component is
+        // processed separately to keep the integrator chain short.
+        template <int ORDER>
+        inline int processOrder(int count, const T* in, T* out) {
+            const float* inf = (const float*)in;
+            float* outf = (float*)out;
+            const int decim = _decimation;
+            const float scale = inScale;
+            const double norm = outScale;
+
+            int outCount = 0;
+            int ph = phase;
+            for (int c = 0; c < comps; c++) {
+                uint64_t integ[ORDER];
+                uint64_t comb[ORDER];
+                memcpy(integ, integs[c], sizeof(integ));
+                memcpy(comb, combs[c], sizeof(comb));
+                ph = phase;
+                outCount = 0;
+
+                for (int i = 0; i < count;) {
+                    // Integrators, up to the next output or the end of the input
+                    int end = std::min<int>(i + decim - ph, count);
+                    ph += end - i;
+                    for (; i < end; i++) {
+                        float x = std::max<float>(inf[i*comps + c], -CIC_MAX_INPUT);
+                        x = std::min<float>(x, CIC_MAX_INPUT);
+                        uint64_t v = (uint64_t)(int64_t)(x * scale);
+                        for (int k = 0; k < ORDER; k++) {
+                            integ[k] += v;
+                            v = integ[k];
+                        }
+                    }
+                    if (ph < decim) { break; }
+                    ph = 0;
+
+                    // Combs
+                    uint64_t v = integ[ORDER - 1];
+                    for (int k = 0; k < ORDER; k++) {
+                        uint64_t diff = v - comb[k];
+                        comb[k] = v;
+                        v = diff;
+                    }
+                    outf[(outCount++)*comps + c] = (double)(int64_t)v * norm;
+                }
+
+                memcpy(integs[c], integ, sizeof(integ));
+                memcpy(combs[c], comb, sizeof(comb));
+            }
+            phase = ph;
+            return outCount;
+        }
+
+        void configure() {
+            // The output grows by order*log2(decimation) bits, use fewer fractional bits if needed to fit in 63 bits
+            int growth = ceil((double)_order * log2((double)_decimation));
+            int fracBits = std::min<int>(CIC_FRAC_BITS, 62 - growth - (int)ceil(log2(CIC_MAX_INPUT)));
+            assert(fracBits >= 8);
+            inScale = (float)(1ull << fracBits);
+            outScale = 1.0 / ((double)(1ull << fracBits) * pow((double)_decimation, _order));
+            clearState();
+        }
+
+        void clearState() {
+            memset(integs, 0, sizeof(integs));
+            memset(combs, 0, sizeof(combs));
+            phase = 0;
+        }
+
+        int _decimation;
+        int _order;
+        float inScale;
+        double outScale;
+
+        uint64_t integs[comps][CIC_MAX_ORDER];
+        uint64_t combs[comps][CIC_MAX_ORDER];
+        int phase = 0;
+    };
+}
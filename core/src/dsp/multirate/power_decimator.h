@@ -1,9 +1,22 @@
 #pragma once
 #include "../filter/decimating_fir.h"
+#include "../filter/half_band_decimator.h"
 #include "../taps/from_array.h"
+#include "../taps/half_band.h"
+#include "cic_decimator.h"
 #include "decim/plans.h"
 
+// Ratios from which a CIC decimator is used as first stage, leaving POWER_DECIM_CIC_FIR_RATIO to the FIR stages
+#define POWER_DECIM_CIC_MIN_RATIO   4096
+#define POWER_DECIM_CIC_FIR_RATIO   16
+#define POWER_DECIM_CIC_ORDER       4
+
+// Fraction of the final output band that half-band stages protect from aliasing
+#define POWER_DECIM_HB_BAND         0.8
+
 namespace dsp::multirate {
+    // setRatio() returns before the change takes effect. The stages of the new ratio are built on the calling
+    // thread and the worker only swaps them in before its next chunk.
     template<class T>
     class PowerDecimator : public Processor<T, T> {
         using base_type = Processor<T, T>;
@@ -15,13 +28,13 @@ namespace dsp::multirate {
         ~PowerDecimator() {
             if (!base_type::_block_init) { return; }
             base_type::stop();
-            freeFirs();
+            freePlan(plan);
+            freeRetired();
         }
 
         void init(stream<T>* in, unsigned int ratio) {
             assert(checkRatio(ratio));
-            _ratio = ratio;
-            reconfigure();
+            plan = buildPlan(ratio);
             base_type::init(in);
         }
 
@@ -29,38 +42,57 @@ namespace dsp::multirate {
             return 1 << decim::plans_len;
         }
 
+        // Taps and decimation of the first stage used for a ratio too low for the CIC, so that another block
+        // can fuse it with its own processing and leave the rest of the ratio to a PowerDecimator. The taps
+        // are half-band taps when the decimation is two, they must be freed by the caller.
+        static tap<float> firstStage(unsigned int ratio, unsigned int& decimation) {
+            assert(ratio >= 2 && ratio < POWER_DECIM_CIC_MIN_RATIO);
+            const decim::stage& st = decim::plans[(int)log2(ratio) - 1].stages[0];
+            decimation = st.decimation;
+            return stageTaps(st, ratio / st.decimation, false);
+        }
+
         void setRatio(unsigned int ratio) {
             assert(base_type::_block_init);
+            assert(checkRatio(ratio));
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _ratio = ratio;
-            reconfigure();
-            base_type::tempStart();
+            freeRetired();
+            Plan next = buildPlan(ratio);
+            base_type::update([this, next]() { swapPlan(next); });
         }
 
         void reset() {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
-            for (auto& fir : decimFirs) {
-                fir->reset();
+            if (plan.cic) { plan.cic->reset(); }
+            for (auto& stage : plan.stages) {
+                if (stage.halfBand) { stage.halfBand->reset(); }
+                else { stage.fir->reset(); }
             }
             base_type::tempStart();
         }
 
         inline int process(int count, const T* in, T* out) {
             // If the ratio is 1, no need to decimate
-            if (_ratio == 1) {
+            if (plan.ratio == 1) {
                 memcpy(out, in, count * sizeof(T));
                 return count;
             }
             
             // Process data through each stage
             const T* data = in;
-            int last = stageCount - 1;
-            for (int i = 0; i < stageCount; i++) {
-                auto fir = decimFirs[i];
-                count = fir->process(count, data, out);
+            if (plan.cic) {
+                count = plan.cic->process(count, data, out);
+                data = out;
+            }
+            for (auto& stage : plan.stages) {
+                if (stage.halfBand) {
+                    count = stage.halfBand->process(count, data, out);
+                }
+                else {
+                    count = stage.fir->process(count, data, out);
+                }
                 data = out;
             }
             return count;
@@ -81,40 +113,109 @@ namespace dsp::multirate {
         }
 
     protected:
-        void freeFirs() {
-            for (auto& fir : decimFirs) { delete fir; }
-            for (auto& taps : decimTaps) { taps::free(taps); }
-            decimFirs.clear();
-            decimTaps.clear();
-        }
-
-        void reconfigure() {
-            // Delete DDC FIRs and taps
-            freeFirs();
+        struct Stage {
+            filter::DecimatingFIR<T, float>* fir = NULL;
+            filter::HalfBandDecimator<T>* halfBand = NULL;
+        };
+
+        // Everything a ratio needs
+        struct Plan {
+            unsigned int ratio = 1;
+            CICDecimator<T>* cic = NULL;
+            std::vector<Stage> stages;
+            std::vector<tap<float>> decimTaps;
+        };
+
+        static Plan buildPlan(unsigned int ratio) {
+            Plan plan;
+            plan.ratio = ratio;
+            if (ratio <= 1) { return plan; }
+
+            // For very large ratios, a CIC does most of the decimation and the plan only does the rest
+            unsigned int firRatio = ratio;
+            if (ratio >= POWER_DECIM_CIC_MIN_RATIO) {
+                firRatio = POWER_DECIM_CIC_FIR_RATIO;
+                plan.cic = new CICDecimator<T>(NULL, ratio / firRatio, POWER_DECIM_CIC_ORDER);
+                plan.cic->out.free();
+            }
 
             // Generate filters based on DDC plan
-            if (_ratio > 1) {
-                int planId = log2(_ratio) - 1;
-                decim::plan plan = decim::plans[planId];
-                stageCount = plan.stageCount;
-                for (int i = 0; i < stageCount; i++) {
-                    tap<float> taps = taps::fromArray<float>(plan.stages[i].tapcount, plan.stages[i].taps);
-                    auto fir = new filter::DecimatingFIR<T, float>(NULL, taps, plan.stages[i].decimation);
-                    fir->out.free();
-                    decimTaps.push_back(taps);
-                    decimFirs.push_back(fir);
+            int planId = log2(firRatio) - 1;
+            const decim::plan& dplan = decim::plans[planId];
+            unsigned int remaining = firRatio;
+            for (int i = 0; i < dplan.stageCount; i++) {
+                const decim::stage& st = dplan.stages[i];
+                remaining /= st.decimation;
+                Stage stage;
+                tap<float> taps = stageTaps(st, remaining, plan.cic && !i);
+
+                if (st.decimation == 2) {
+                    stage.halfBand = new filter::HalfBandDecimator<T>(NULL, taps);
+                    stage.halfBand->out.free();
+                    taps::free(taps);
+                    plan.stages.push_back(stage);
+                    continue;
                 }
+
+                stage.fir = new filter::DecimatingFIR<T, float>(NULL, taps, st.decimation);
+                stage.fir->out.free();
+                plan.decimTaps.push_back(taps);
+                plan.stages.push_back(stage);
+            }
+            return plan;
+        }
+
+        static void freePlan(Plan& plan) {
+            if (plan.cic) { delete plan.cic; }
+            for (auto& stage : plan.stages) {
+                if (stage.fir) { delete stage.fir; }
+                if (stage.halfBand) { delete stage.halfBand; }
+            }
+            for (auto& taps : plan.decimTaps) { taps::free(taps); }
+            plan.cic = NULL;
+            plan.stages.clear();
+            plan.decimTaps.clear();
+        }
+
+        // Called by the worker, the replaced plan is freed by the next setter or the destructor
+        void swapPlan(const Plan& next) {
+            {
+                std::lock_guard<std::mutex> lck(retiredMtx);
+                retired.push_back(plan);
+            }
+            plan = next;
+        }
+
+        void freeRetired() {
+            std::vector<Plan> list;
+            {
+                std::lock_guard<std::mutex> lck(retiredMtx);
+                list.swap(retired);
+            }
+            for (auto& p : list) { freePlan(p); }
+        }
+
+        static tap<float> stageTaps(const decim::stage& st, unsigned int remaining, bool afterCIC) {
+            // Decimations by two use a half-band designed to protect the final band
+            if (st.decimation == 2) {
+                double band = POWER_DECIM_HB_BAND * 0.25 / (double)remaining;
+                return taps::halfBand(0.5 - 2.0*band, 1.0);
+            }
+
+            // Otherwise use the plan's taps, correcting the droop of the CIC in the stage following it
+            if (afterCIC) {
+                return CICDecimator<T>::compensate(st.taps, st.tapcount, POWER_DECIM_CIC_ORDER);
             }
+            return taps::fromArray<float>(st.tapcount, st.taps);
         }
 
-        bool checkRatio(unsigned int ratio) {
+        static bool checkRatio(unsigned int ratio) {
             // Make sure ratio is a power of two, non-zero and lower or equal to maximum
             return ((ratio & (ratio - 1)) == 0) && ratio && ratio <= getMaxRatio();
         }
 
-        std::vector<filter::DecimatingFIR<T, float>*> decimFirs;
-        std::vector<tap<float>> decimTaps;
-        unsigned int _ratio;
-        int stageCount;
+        Plan plan;
+        std::mutex retiredMtx;
+        std::vector<Plan> retired;
     };
 }
\ No newline at end of file
@@ -5,11 +5,21 @@
 #include "../filter/decimating_fir.h"
 #include "../taps/from_array.h"
 #include "polyphase_resampler.h"
+#include "arbitrary_resampler.h"
 #include "power_decimator.h"
 #include "../taps/low_pass.h"
+#include "../taps/estimate_tap_count.h"
 #include "../window/nuttall.h"
 
+// Largest rational filter bank allowed before switching to the arbitrary ratio resampler
+#define RATIONAL_RESAMP_MAX_TAPS    16384
+
+// Maximum error on the output samplerate allowed for the rational resampler, in percent
+#define RATIONAL_RESAMP_MAX_ERROR   0.01
+
 namespace dsp::multirate {
+    // The setters return before the change takes effect. The stages for the new rates (taps, filter banks, power
+    // decimator) are built on the calling thread and the worker only swaps them in before its next chunk.
     template<class T>
     class RationalResampler : public Processor<T, T> {
         using base_type = Processor<T, T>;
@@ -21,24 +31,14 @@ namespace dsp::multirate {
         ~RationalResampler() {
             if (!base_type::_block_init) { return; }
             base_type::stop();
-            taps::free(rtaps);
+            freeStages(stages);
+            freeRetired();
         }
 
         void init(stream<T>* in, double inSamplerate, double outSamplerate) {
             _inSamplerate = inSamplerate;
             _outSamplerate = outSamplerate;
-            
-            // Dummy initialization since only used for processing
-            rtaps = taps::lowPass(0.25, 0.1, 1.0);
-            decim.init(NULL, 2);
-            resamp.init(NULL, 1, 1, rtaps);
-
-            decim.out.free();
-            resamp.out.free();
-
-            // Proper configuration
-            reconfigure();
-
+            stages = buildStages(_inSamplerate, _outSamplerate);
             base_type::init(in);
         }
 
@@ -46,48 +46,39 @@ namespace dsp::multirate {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
             base_type::tempStop();
-            decim.reset();
-            resamp.reset();
+            if (stages.decim) { stages.decim->reset(); }
+            if (stages.resamp) { stages.resamp->reset(); }
+            if (stages.arbResamp) { stages.arbResamp->reset(); }
             base_type::tempStart();
         }
 
         void setInSamplerate(double inSamplerate) {
-            assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _inSamplerate = inSamplerate;
-            reconfigure();
-            base_type::tempStart();
+            setRates(inSamplerate, _outSamplerate);
         }
 
         void setOutSamplerate(double outSamplerate) {
-            assert(base_type::_block_init);
-            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
-            _outSamplerate = outSamplerate;
-            reconfigure();
-            base_type::tempStart();
+            setRates(_inSamplerate, outSamplerate);
         }
 
         void setRates(double inSamplerate, double outSamplerate) {
             assert(base_type::_block_init);
             std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
-            base_type::tempStop();
+            freeRetired();
             _inSamplerate = inSamplerate;
             _outSamplerate = outSamplerate;
-            reconfigure();
-            base_type::tempStart();
+            Stages next = buildStages(_inSamplerate, _outSamplerate);
+            base_type::update([this, next]() { swapStages(next); });
         }
 
         inline int process(int count, const T* in, T* out) {
-            switch(mode) {
+            switch(stages.mode) {
                 case Mode::BOTH:
-                    count = decim.process(count, in, out);
-                    return resamp.process(count, out, out);
+                    count = stages.decim->process(count, in, out);
+                    return resample(count, out, out);
                 case Mode::DECIM_ONLY:
-                    return decim.process(count, in, out);
+                    return stages.decim->process(count, in, out);
                 case Mode::RESAMP_ONLY:
-                    return resamp.process(count, in, out);
+                    return resample(count, in, out);
                 case Mode::NONE:
                     memcpy(out, in, count * sizeof(T));
                     return count;
@@ -117,58 +108,112 @@ namespace dsp::multirate {
             NONE
         };
 
-        void reconfigure() {
+        // Only the stages a pair of rates needs are allocated, the taps belong to whichever resampler is used
+        struct Stages {
+            PowerDecimator<T>* decim = NULL;
+            PolyphaseResampler<T>* resamp = NULL;
+            ArbitraryResampler<T>* arbResamp = NULL;
+            tap<float> taps;
+            Mode mode = Mode::NONE;
+        };
+
+        inline int resample(int count, const T* in, T* out) {
+            if (stages.arbResamp) { return stages.arbResamp->process(count, in, out); }
+            return stages.resamp->process(count, in, out);
+        }
+
+        static Stages buildStages(double inSamplerate, double outSamplerate) {
+            Stages st;
+
             // Calculate highest power-of-two decimation for the power decimator 
-            int predecPower = std::min<int>(floor(log2(_inSamplerate / _outSamplerate)), PowerDecimator<T>::getMaxRatio());
+            int predecPower = std::min<int>(floor(log2(inSamplerate / outSamplerate)), PowerDecimator<T>::getMaxRatio());
             int predecRatio = std::min<int>(1 << predecPower, PowerDecimator<T>::getMaxRatio());
-            double intSamplerate = _inSamplerate;
+            double intSamplerate = inSamplerate;
 
             // Configure the DDC
-            bool useDecim = (_inSamplerate > _outSamplerate && predecPower > 0);
+            bool useDecim = (inSamplerate > outSamplerate && predecPower > 0);
             if (useDecim) {
-                intSamplerate = _inSamplerate / (double)predecRatio;
-                decim.setRatio(predecRatio);
+                intSamplerate = inSamplerate / (double)predecRatio;
+                st.decim = new PowerDecimator<T>(NULL, predecRatio);
+                st.decim->out.free();
             }
 
             // Calculate interpolation and decimation for polyphase resampler
             int IntSR = round(intSamplerate);
-            int OutSR = round(_outSamplerate);
+            int OutSR = round(outSamplerate);
             int gcd = std::gcd(IntSR, OutSR);
             int interp = OutSR / gcd;
             int decim = IntSR / gcd;
 
-            // Check for excessive error
+            // Check the error due to rounding the samplerates
             double actualOutSR = (double)IntSR * (double)interp / (double)decim;
-            double error = abs((actualOutSR - _outSamplerate) / _outSamplerate) * 100.0;
-            if (error > 0.01) {
-                fprintf(stderr, "Warning: resampling error is over 0.01%%: %lf\n", error);
-            }
+            double error = abs((actualOutSR - outSamplerate) / outSamplerate) * 100.0;
             
             // If the power decimator already did all the work, don't use the resampler
-            if (interp == decim) {
-                mode = useDecim ? Mode::DECIM_ONLY : Mode::NONE;
-                return;
+            if (interp == decim && error <= RATIONAL_RESAMP_MAX_ERROR) {
+                st.mode = useDecim ? Mode::DECIM_ONLY : Mode::NONE;
+                return st;
             }
+            st.mode = useDecim ? Mode::BOTH : Mode::RESAMP_ONLY;
 
-            // Configure the polyphase resampler
+            // If the ratio needs a large polyphase bank or can't be represented accurately, use the arbitrary
+            // resampler whose bank size only depends on the bandwidth
             double tapSamplerate = intSamplerate * (double)interp;
-            double tapBandwidth = std::min<double>(_inSamplerate, _outSamplerate) / 2.0;
+            double tapBandwidth = std::min<double>(inSamplerate, outSamplerate) / 2.0;
             double tapTransWidth = tapBandwidth * 0.1;
-            taps::free(rtaps);
-            rtaps = taps::lowPass(tapBandwidth, tapTransWidth, tapSamplerate);
-            for (int i = 0; i < rtaps.size; i++) { rtaps.taps[i] *= (float)interp; }
-            resamp.setRatio(interp, decim, rtaps);
+            if (taps::estimateTapCount(tapTransWidth, tapSamplerate) > RATIONAL_RESAMP_MAX_TAPS || error > RATIONAL_RESAMP_MAX_ERROR) {
+                st.taps = taps::lowPass(tapBandwidth, tapTransWidth, intSamplerate * (double)ARBITRARY_RESAMP_PHASES);
+                for (int i = 0; i < st.taps.size; i++) { st.taps.taps[i] *= (float)ARBITRARY_RESAMP_PHASES; }
+                st.arbResamp = new ArbitraryResampler<T>(NULL, outSamplerate / intSamplerate, st.taps);
+                st.arbResamp->out.free();
+                return st;
+            }
 
-            printf("[Resamp] predec: %d, interp: %d, decim: %d, inacc: %lf%%, taps: %d\n", predecRatio, interp, decim, error, rtaps.size);
+            // Configure the polyphase resampler
+            st.taps = taps::lowPass(tapBandwidth, tapTransWidth, tapSamplerate);
+            for (int i = 0; i < st.taps.size; i++) { st.taps.taps[i] *= (float)interp; }
+            st.resamp = new PolyphaseResampler<T>(NULL, interp, decim, st.taps);
+            st.resamp->out.free();
 
-            mode = useDecim ? Mode::BOTH : Mode::RESAMP_ONLY;
+            printf("[Resamp] predec: %d, interp: %d, decim: %d, inacc: %lf%%, taps: %d\n", predecRatio, interp, decim, error, st.taps.size);
+
+            return st;
         }
-        
-        PowerDecimator<T> decim;
-        PolyphaseResampler<T> resamp;
-        tap<float> rtaps;
+
+        static void freeStages(Stages& st) {
+            if (st.decim) { delete st.decim; }
+            if (st.resamp) { delete st.resamp; }
+            if (st.arbResamp) { delete st.arbResamp; }
+            taps::free(st.taps);
+            st.decim = NULL;
+            st.resamp = NULL;
+            st.arbResamp = NULL;
+        }
+
+        // Called by the worker, the replaced stages are freed by the next setter or the destructor
+        void swapStages(const Stages& next) {
+            {
+                std::lock_guard<std::mutex> lck(retiredMtx);
+                retired.push_back(stages);
+            }
+            stages = next;
+        }
+
+        void freeRetired() {
+            std::vector<Stages> list;
+            {
+                std::lock_guard<std::mutex> lck(retiredMtx);
+                list.swap(retired);
+            }
+            for (auto& st : list) { freeStages(st); }
+        }
+
+        Stages stages;
+        std::mutex retiredMtx;
+        std::vector<Stages> retired;
+
+        // Latest settings, only used by the setters
         double _inSamplerate;
         double _outSamplerate;
-        Mode mode;
     };
 }
\ No newline at end of file
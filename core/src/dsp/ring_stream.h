@@ -0,0 +1,195 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include "stream.h"
+
+// Number of polling iterations before a waiting side parks on its condition variable
+#define RING_STREAM_SPIN_COUNT  256
+
+namespace dsp {
+    // Single-producer/single-consumer drop-in replacement for stream<T>. Instead of a double buffer
+    // guarded by two mutexes, the writer and reader exchange buffers through a lock-free ring of
+    // 'depth' slots so that several chunks can be in flight. Waiting is spin-then-park: both sides
+    // poll for a short while and only fall back to a condition variable if nothing happens.
+    // Since it overrides the virtual stream<T> interface, any block that takes a stream<T>* as
+    // input (or a Splitter output) can use it without modification.
+    template <class T>
+    class ring_stream : public stream<T> {
+        using base_type = stream<T>;
+    public:
+        ring_stream(int depth = 4, int bufferSize = STREAM_BUFFER_SIZE) : base_type(false) {
+            // A minimum of two slots is required, one owned by the writer and one by the reader
+            _depth = std::max<int>(depth, 2);
+            allocSlots(bufferSize);
+        }
+
+        ~ring_stream() {
+            freeSlots();
+        }
+
+        void setBufferSize(int samples) {
+            freeSlots();
+            allocSlots(samples);
+        }
+
+        inline bool swap(int size) {
+            // Wait until the slot following the one being written is free
+            uint64_t h = head.load(std::memory_order_relaxed);
+            wait([this, h]() { return (h + 1 - tail.load()) < (uint64_t)_depth || writerStop.load(); }, swapCV, writerParked);
+
+            // If writer was stopped, abandon operation
+            if (writerStop.load()) { return false; }
+
+            // Publish the chunk and take ownership of the next slot
+            sizes[h % _depth] = size;
+            base_type::trackChunk(size);
+            head.store(h + 1);
+            base_type::writeBuf = slots[(h + 1) % _depth];
+
+            // Wake up the reader if it gave up spinning
+            notify(rdyCV, readerParked);
+            getScheduler().wake();
+
+            return true;
+        }
+
+        inline int read() {
+            // Wait for a chunk to be published or to be stopped
+            uint64_t t = tail.load(std::memory_order_relaxed);
+            wait([this, t]() { return head.load() > t || readerStop.load(); }, rdyCV, readerParked);
+            if (readerStop.load()) { return -1; }
+
+            // Expose the oldest chunk to the reader
+            base_type::readBuf = slots[t % _depth];
+            reading = true;
+            return sizes[t % _depth];
+        }
+
+        inline void flush() {
+            // Only release a slot if one was actually acquired with read()
+            if (!reading) { return; }
+            reading = false;
+            tail.fetch_add(1);
+
+            // Wake up the writer if it gave up spinning
+            notify(swapCV, writerParked);
+            getScheduler().wake();
+        }
+
+        void stopWriter() {
+            writerStop = true;
+            {
+                std::lock_guard<std::mutex> lck(parkMtx);
+            }
+            swapCV.notify_all();
+            getScheduler().wake();
+        }
+
+        void clearWriteStop() {
+            writerStop = false;
+        }
+
+        void stopReader() {
+            readerStop = true;
+            {
+                std::lock_guard<std::mutex> lck(parkMtx);
+            }
+            rdyCV.notify_all();
+            getScheduler().wake();
+        }
+
+        void clearReadStop() {
+            readerStop = false;
+        }
+
+        bool readable() {
+            return head.load() > tail.load() || readerStop.load();
+        }
+
+        bool writable() {
+            return (head.load() + 1 - tail.load()) < (uint64_t)_depth || writerStop.load();
+        }
+
+        // Number of chunks published but not yet released by the reader
+        int available() {
+            return head.load() - tail.load();
+        }
+
+        int getDepth() {
+            return _depth;
+        }
+
+    private:
+        void allocSlots(int samples) {
+            slots.resize(_depth);
+            sizes.resize(_depth);
+            for (int i = 0; i < _depth; i++) {
+                slots[i] = buffer::alloc<T>(samples);
+                sizes[i] = 0;
+            }
+            head = 0;
+            tail = 0;
+            reading = false;
+            base_type::writeBuf = slots[0];
+            base_type::readBuf = slots[0];
+            base_type::bufferSize = samples;
+            base_type::bufferCount = _depth;
+        }
+
+        void freeSlots() {
+            for (auto& slot : slots) {
+                if (slot) { buffer::free(slot); }
+            }
+            slots.clear();
+
+            // Prevent the base class from freeing the slots a second time
+            base_type::writeBuf = NULL;
+            base_type::readBuf = NULL;
+            base_type::bufferCount = 0;
+        }
+
+        template <class Pred>
+        inline void wait(Pred pred, std::condition_variable& cv, std::atomic<bool>& parked) {
+            // Spin for a little while, most of the time the other side is about to catch up
+            for (int i = 0; i < RING_STREAM_SPIN_COUNT; i++) {
+                if (pred()) { return; }
+                if (i >= RING_STREAM_SPIN_COUNT / 2) { std::this_thread::yield(); }
+            }
+
+            // Park until notified
+            std::unique_lock<std::mutex> lck(parkMtx);
+            parked = true;
+            cv.wait(lck, pred);
+            parked = false;
+        }
+
+        inline void notify(std::condition_variable& cv, std::atomic<bool>& parked) {
+            // Avoid the syscall entirely unless the other side is actually parked
+            if (!parked.load()) { return; }
+            {
+                std::lock_guard<std::mutex> lck(parkMtx);
+            }
+            cv.notify_all();
+        }
+
+        int _depth;
+        std::vector<T*> slots;
+        std::vector<int> sizes;
+
+        // Writer and reader counters live on separate cache lines to avoid false sharing
+        alignas(64) std::atomic<uint64_t> head = 0;
+        alignas(64) std::atomic<uint64_t> tail = 0;
+        bool reading = false;
+
+        std::mutex parkMtx;
+        std::condition_variable swapCV;
+        std::condition_variable rdyCV;
+        std::atomic<bool> writerParked = false;
+        std::atomic<bool> readerParked = false;
+
+        std::atomic<bool> readerStop = false;
+        std::atomic<bool> writerStop = false;
+    };
+}
@@ -19,11 +19,11 @@ namespace dsp::routing {
                 throw std::runtime_error("[Splitter] Tried to bind stream to that is already bound");
             }
 
-            // Add to the list
-            base_type::tempStop();
-            base_type::registerOutput(stream);
-            streams.push_back(stream);
-            base_type::tempStart();
+            // Add to the list between two chunks, the other outputs keep being fed
+            base_type::updateSync([this, stream]() {
+                base_type::registerOutput(stream);
+                streams.push_back(stream);
+            });
         }
 
         void unbindStream(stream<T>* stream) {
@@ -36,11 +36,11 @@ namespace dsp::routing {
                 throw std::runtime_error("[Splitter] Tried to unbind stream to that isn't bound");
             }
 
-            // Add to the list
-            base_type::tempStop();
-            streams.erase(sit);
-            base_type::unregisterOutput(stream);
-            base_type::tempStart();
+            // Remove from the list, once this returns the stream is no longer written to
+            base_type::updateSync([this, stream]() {
+                streams.erase(std::find(streams.begin(), streams.end(), stream));
+                base_type::unregisterOutput(stream);
+            });
         }
 
         int run() {
@@ -0,0 +1,233 @@
+#include "scheduler.h"
+#include "block.h"
+#include <typeinfo>
+#include <algorithm>
+#include <stdio.h>
+
+// Maximum time an idle worker stays parked without being woken by a stream
+#define SCHEDULER_PARK_TIMEOUT_MS   100
+
+namespace dsp {
+    Scheduler::~Scheduler() {
+        stop();
+    }
+
+    void Scheduler::start(int threads) {
+        std::lock_guard<std::mutex> lck(ctrlMtx);
+        if (running) { return; }
+
+        // Default to one worker per core
+        if (threads <= 0) { threads = std::max<int>(std::thread::hardware_concurrency(), 1); }
+
+        // Create the workers and distribute already registered tasks
+        for (int i = 0; i < threads; i++) {
+            workers.push_back(new Worker);
+        }
+        {
+            std::lock_guard<std::mutex> lck2(tasksMtx);
+            int i = 0;
+            for (auto& [blk, task] : tasks) {
+                pushTask(i++ % threads, task);
+            }
+        }
+
+        // Start the workers
+        running = true;
+        for (int i = 0; i < threads; i++) {
+            workers[i]->thread = std::thread(&Scheduler::worker, this, i);
+        }
+    }
+
+    void Scheduler::stop() {
+        std::lock_guard<std::mutex> lck(ctrlMtx);
+        if (!running) { return; }
+
+        // Stop and delete the workers, tasks stay registered in case the pool is restarted
+        running = false;
+        {
+            std::lock_guard<std::mutex> lck2(parkMtx);
+        }
+        parkCV.notify_all();
+        for (auto& w : workers) {
+            if (w->thread.joinable()) { w->thread.join(); }
+        }
+        for (auto& w : workers) {
+            delete w;
+        }
+        workers.clear();
+    }
+
+    bool Scheduler::isRunning() {
+        return running;
+    }
+
+    int Scheduler::getThreadCount() {
+        std::lock_guard<std::mutex> lck(ctrlMtx);
+        return workers.size();
+    }
+
+    void Scheduler::addBlock(block* blk) {
+        std::lock_guard<std::mutex> lck(ctrlMtx);
+        Task* task;
+        {
+            std::lock_guard<std::mutex> lck2(tasksMtx);
+            if (tasks.find(blk) != tasks.end()) { return; }
+            task = new Task;
+            task->blk = blk;
+            tasks[blk] = task;
+        }
+        if (!workers.empty()) {
+            pushTask(nextWorker++ % workers.size(), task);
+            wake();
+        }
+    }
+
+    void Scheduler::removeBlock(block* blk) {
+        Task* task;
+        {
+            std::lock_guard<std::mutex> lck(tasksMtx);
+            auto it = tasks.find(blk);
+            if (it == tasks.end()) { return; }
+            task = it->second;
+        }
+
+        // Either take the task out of a queue or wait for the worker executing it to drop it
+        task->removed = true;
+        while (!dequeue(task) && !task->dropped) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        std::lock_guard<std::mutex> lck(tasksMtx);
+        tasks.erase(blk);
+        delete task;
+    }
+
+    std::vector<Scheduler::BlockStats> Scheduler::getStats() {
+        std::lock_guard<std::mutex> lck(tasksMtx);
+        std::vector<BlockStats> stats;
+        for (auto& [blk, task] : tasks) {
+            stats.push_back({ blk, typeid(*blk).name(), blk->getRunTime(), blk->getRunCount() });
+        }
+        return stats;
+    }
+
+    std::string Scheduler::report() {
+        auto stats = getStats();
+        char line[512];
+        std::string out;
+        snprintf(line, sizeof(line), "DSP pool: %d threads, %zu blocks\n", getThreadCount(), stats.size());
+        out += line;
+
+        // List the blocks, the most time consuming first
+        std::sort(stats.begin(), stats.end(), [](const BlockStats& a, const BlockStats& b) { return a.runTimeNs > b.runTimeNs; });
+        for (auto& s : stats) {
+            double avgUs = s.runs ? (s.runTimeNs / 1000.0) / s.runs : 0.0;
+            snprintf(line, sizeof(line), "  %s (%p): %.1f ms in %llu runs, %.1f us per run\n", s.name.c_str(), (void*)s.blk, s.runTimeNs / 1e6, (unsigned long long)s.runs, avgUs);
+            out += line;
+        }
+        return out;
+    }
+
+    void Scheduler::worker(int id) {
+        int misses = 0;
+        uint64_t seq = wakeSeq.load();
+        while (running) {
+            Task* task = popTask(id);
+
+            // Execute the task only if it won't block
+            bool executed = false;
+            if (task && !task->removed && task->blk->isReady()) {
+                task->blk->timedRun();
+                executed = true;
+            }
+
+            // Put the task back in the queue unless it's being removed
+            if (task) {
+                if (task->removed) {
+                    task->dropped = true;
+                }
+                else {
+                    pushTask(id, task);
+                }
+            }
+
+            // Park when a whole round of tasks went by without anything to do and no stream changed meanwhile
+            if (executed) {
+                misses = 0;
+                seq = wakeSeq.load();
+                continue;
+            }
+            int queued;
+            {
+                std::lock_guard<std::mutex> lck(workers[id]->mtx);
+                queued = workers[id]->queue.size();
+            }
+            if (++misses <= queued) { continue; }
+            misses = 0;
+            {
+                std::unique_lock<std::mutex> lck(parkMtx);
+                parkedWorkers++;
+                if (running && wakeSeq.load() == seq) {
+                    parkCV.wait_for(lck, std::chrono::milliseconds(SCHEDULER_PARK_TIMEOUT_MS));
+                }
+                parkedWorkers--;
+            }
+            seq = wakeSeq.load();
+        }
+    }
+
+    Scheduler::Task* Scheduler::popTask(int id) {
+        // Take the oldest task from our own queue
+        {
+            std::lock_guard<std::mutex> lck(workers[id]->mtx);
+            auto& q = workers[id]->queue;
+            if (!q.empty()) {
+                Task* task = q.front();
+                q.pop_front();
+                return task;
+            }
+        }
+
+        // Otherwise steal the newest task from another worker
+        int count = workers.size();
+        for (int i = 1; i < count; i++) {
+            Worker* victim = workers[(id + i) % count];
+            std::lock_guard<std::mutex> lck(victim->mtx);
+            if (!victim->queue.empty()) {
+                Task* task = victim->queue.back();
+                victim->queue.pop_back();
+                return task;
+            }
+        }
+
+        return NULL;
+    }
+
+    void Scheduler::pushTask(int id, Task* task) {
+        std::lock_guard<std::mutex> lck(workers[id]->mtx);
+        workers[id]->queue.push_back(task);
+    }
+
+    bool Scheduler::dequeue(Task* task) {
+        std::lock_guard<std::mutex> lck(ctrlMtx);
+
+        // If the pool isn't running, nothing can be executing the task
+        if (!running) { return true; }
+
+        for (auto& w : workers) {
+            std::lock_guard<std::mutex> lck2(w->mtx);
+            auto it = std::find(w->queue.begin(), w->queue.end(), task);
+            if (it != w->queue.end()) {
+                w->queue.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Scheduler& getScheduler() {
+        // Never destroyed so that blocks stopped during static destruction can still unregister
+        static Scheduler* sched = new Scheduler;
+        return *sched;
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+namespace dsp {
+    class block;
+
+    // Optional replacement for the thread-per-block model. When running, blocks that have at least
+    // one input are turned into tasks that are dispatched onto a fixed pool of worker threads
+    // instead of getting their own thread. A task is only executed when all of its inputs have
+    // data and all of its outputs can be swapped so that run() never blocks a worker. Idle
+    // workers steal tasks from the other workers' queues and park once a whole round went by without
+    // anything ready, until a stream wakes them. Blocks with no input (sources), blocks that can block
+    // within run() and blocks managing their own threads are left untouched.
+    class Scheduler {
+    public:
+        struct BlockStats {
+            const block* blk;
+            std::string name;
+            uint64_t runTimeNs;
+            uint64_t runs;
+        };
+
+        Scheduler() {}
+        ~Scheduler();
+
+        // Start the worker pool, a thread count of zero means one worker per CPU core
+        void start(int threads = 0);
+        void stop();
+        bool isRunning();
+        int getThreadCount();
+
+        // Called by blocks when they are started and stopped. removeBlock() returns only once the block is no longer executing.
+        void addBlock(block* blk);
+        void removeBlock(block* blk);
+
+        // Wall time spent in run() by every block scheduled on the pool
+        std::vector<BlockStats> getStats();
+        std::string report();
+
+        // Called by streams whenever a read or a swap may have become possible. The sequence is bumped
+        // before checking for parked workers, which count themselves before checking the sequence, so
+        // either the stream sees the worker or the worker sees the change.
+        inline void wake() {
+            if (!running.load(std::memory_order_relaxed)) { return; }
+            wakeSeq.fetch_add(1);
+            if (!parkedWorkers.load()) { return; }
+            {
+                std::lock_guard<std::mutex> lck(parkMtx);
+            }
+            parkCV.notify_all();
+        }
+
+    private:
+        struct Task {
+            block* blk;
+            std::atomic<bool> removed = false;
+            std::atomic<bool> dropped = false;
+        };
+
+        struct Worker {
+            std::mutex mtx;
+            std::deque<Task*> queue;
+            std::thread thread;
+        };
+
+        void worker(int id);
+        Task* popTask(int id);
+        void pushTask(int id, Task* task);
+        bool dequeue(Task* task);
+
+        std::vector<Worker*> workers;
+        std::atomic<bool> running = false;
+        std::mutex ctrlMtx;
+
+        std::mutex tasksMtx;
+        std::map<block*, Task*> tasks;
+        std::atomic<int> nextWorker = 0;
+
+        std::mutex parkMtx;
+        std::condition_variable parkCV;
+        std::atomic<uint64_t> wakeSeq = 0;
+        std::atomic<int> parkedWorkers = 0;
+    };
+
+    // Scheduler shared by the core and all modules
+    Scheduler& getScheduler();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "../sink.h"
+#include "../buffer/fifo.h"
+
+namespace dsp::sink {
+    // Writes its input to a FIFO, waiting for space when it's full. Meant to feed a callback-driven
+    // consumer such as an audio device, which can use fifo.tryRead() to never block.
+    template <class T>
+    class FIFO : public Sink<T> {
+        using base_type = Sink<T>;
+    public:
+        FIFO() {}
+
+        FIFO(stream<T>* in, int capacity) { init(in, capacity); }
+
+        void init(stream<T>* in, int capacity) {
+            fifo.init(capacity);
+            base_type::init(in);
+
+            // Waits for the consumer to make space, which the pool scheduler can't see
+            base_type::schedulable = false;
+        }
+
+        // Must not be called while the consumer is reading, the content of the FIFO is lost
+        void setCapacity(int capacity) {
+            assert(base_type::_block_init);
+            std::lock_guard<std::recursive_mutex> lck(base_type::ctrlMtx);
+            base_type::tempStop();
+            fifo.setCapacity(capacity);
+            base_type::tempStart();
+        }
+
+        int run() {
+            int count = base_type::_in->read();
+            if (count < 0) { return -1; }
+
+            if (fifo.write(base_type::_in->readBuf, count) < 0) { return -1; }
+
+            base_type::_in->flush();
+            return count;
+        }
+
+        buffer::FIFO<T> fifo;
+
+    private:
+        // The worker may be waiting for space in the FIFO rather than on its input
+        void doStop() {
+            fifo.stopWriter();
+            base_type::doStop();
+            fifo.clearWriteStop();
+        }
+    };
+}
@@ -14,6 +14,9 @@ namespace dsp::sink {
             _handler = handler;
             _ctx = ctx;
             base_type::init(in);
+
+            // The handler can do anything, including blocking on the network, so keep a thread of its own
+            base_type::schedulable = false;
         }
 
         int run() {
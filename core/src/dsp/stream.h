@@ -2,8 +2,11 @@
 #include <string.h>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <algorithm>
 #include <volk/volk.h>
 #include "buffer/buffer.h"
+#include "scheduler.h"
 
 // 1MSample buffer
 #define STREAM_BUFFER_SIZE 1000000
@@ -19,17 +22,21 @@ namespace dsp {
         virtual void clearWriteStop() {}
         virtual void stopReader() {}
         virtual void clearReadStop() {}
+        virtual bool readable() { return true; }
+        virtual bool writable() { return true; }
+
+        // Memory held by the stream's own buffers and the part of it written by the largest chunk so far
+        virtual size_t getBufferBytes() { return 0; }
+        virtual size_t getUsedBytes() { return 0; }
     };
 
     template <class T>
     class stream : public untyped_stream {
     public:
-        stream() {
-            writeBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
-            readBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
-        }
+        stream() : stream(true) {}
 
         virtual ~stream() {
+            buffer::getPool().unregisterStream(this);
             free();
         }
 
@@ -38,6 +45,8 @@ namespace dsp {
             buffer::free(readBuf);
             writeBuf = buffer::alloc<T>(samples);
             readBuf = buffer::alloc<T>(samples);
+            bufferSize = samples;
+            bufferCount = 2;
         }
 
         virtual inline bool swap(int size) {
@@ -51,6 +60,7 @@ namespace dsp {
 
                 // Swap buffers
                 dataSize = size;
+                trackChunk(size);
                 T* temp = writeBuf;
                 writeBuf = readBuf;
                 readBuf = temp;
@@ -63,6 +73,7 @@ namespace dsp {
                 dataReady = true;
             }
             rdyCV.notify_all();
+            getScheduler().wake();
 
             return true;
         }
@@ -89,6 +100,7 @@ namespace dsp {
             }
 
             swapCV.notify_all();
+            getScheduler().wake();
         }
 
         virtual void stopWriter() {
@@ -97,6 +109,7 @@ namespace dsp {
                 writerStop = true;
             }
             swapCV.notify_all();
+            getScheduler().wake();
         }
 
         virtual void clearWriteStop() {
@@ -109,21 +122,62 @@ namespace dsp {
                 readerStop = true;
             }
             rdyCV.notify_all();
+            getScheduler().wake();
         }
 
         virtual void clearReadStop() {
             readerStop = false;
         }
 
+        // Non-blocking checks used by the pool scheduler to know if read() or swap() would block
+        virtual bool readable() {
+            std::lock_guard<std::mutex> lck(rdyMtx);
+            return dataReady || readerStop;
+        }
+
+        virtual bool writable() {
+            std::lock_guard<std::mutex> lck(swapMtx);
+            return canSwap || writerStop;
+        }
+
         void free() {
             if (writeBuf) { buffer::free(writeBuf); }
             if (readBuf) { buffer::free(readBuf); }
             writeBuf = NULL;
             readBuf = NULL;
+            bufferCount = 0;
+        }
+
+        size_t getBufferBytes() {
+            return (size_t)bufferCount * (size_t)bufferSize * sizeof(T);
+        }
+
+        size_t getUsedBytes() {
+            return (size_t)bufferCount * (size_t)std::min<int>(maxChunk, bufferSize) * sizeof(T);
+        }
+
+        T* writeBuf = NULL;
+        T* readBuf = NULL;
+
+    protected:
+        // Derived streams that manage their own buffers skip the allocation of the double buffer
+        stream(bool allocate) {
+            if (allocate) {
+                writeBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+                readBuf = buffer::alloc<T>(STREAM_BUFFER_SIZE);
+                bufferCount = 2;
+            }
+            buffer::getPool().registerStream(this);
+        }
+
+        // Only called by the writer, the atomic is just there so the value can be read from a report
+        inline void trackChunk(int size) {
+            if (size > maxChunk.load(std::memory_order_relaxed)) { maxChunk.store(size, std::memory_order_relaxed); }
         }
 
-        T* writeBuf;
-        T* readBuf;
+        std::atomic<int> bufferSize = STREAM_BUFFER_SIZE;
+        std::atomic<int> bufferCount = 0;
+        std::atomic<int> maxChunk = 0;
 
     private:
         std::mutex swapMtx;
@@ -0,0 +1,33 @@
+#pragma once
+#include <algorithm>
+#include "windowed_sinc.h"
+#include "estimate_tap_count.h"
+#include "../window/nuttall.h"
+
+namespace dsp::taps {
+    // Half-band low pass with its cutoff at a quarter of the samplerate. The tap count is rounded up to
+    // the form 4K-1 so that every other tap is zero except the center one, which is 0.5.
+    inline tap<float> halfBand(double transWidth, double sampleRate) {
+        int count = estimateTapCount(transWidth, sampleRate);
+        count = std::max<int>(((count + 4) / 4) * 4 - 1, 7);
+        tap<float> taps = windowedSinc<float>(count, DB_M_PI / 2.0, window::nuttall);
+
+        // Force the zero taps and normalize the others for exactly unity gain at DC
+        int center = count / 2;
+        double sideSum = 0.0;
+        for (int i = 0; i < count; i++) {
+            if (i == center) { continue; }
+            if ((i - center) % 2 == 0) {
+                taps.taps[i] = 0.0f;
+                continue;
+            }
+            sideSum += taps.taps[i];
+        }
+        for (int i = 0; i < count; i++) {
+            if ((i - center) % 2) { taps.taps[i] *= 0.5 / sideSum; }
+        }
+        taps.taps[center] = 0.5f;
+
+        return taps;
+    }
+}
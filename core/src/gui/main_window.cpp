@@ -27,6 +27,9 @@
 #include <gui/colormaps.h>
 #include <gui/widgets/snr_meter.h>
 #include <gui/tuner.h>
+#include <dsp/buffer/pool.h>
+#include <dsp/scheduler.h>
+#include <dsp/fftw_planner.h>
 
 void MainWindow::init() {
     LoadingScreen::show("Initializing UI");
@@ -39,6 +42,7 @@ void MainWindow::init() {
     json menuElements = core::configManager.conf["menuElements"];
     std::string modulesDir = core::configManager.conf["modulesDirectory"];
     std::string resourcesDir = core::configManager.conf["resourcesDirectory"];
+    int fftThreads = core::configManager.conf["fftThreads"];
     core::configManager.release();
 
     // Assert that directories are absolute
@@ -86,8 +90,12 @@ void MainWindow::init() {
 
     fft_in = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
     fft_out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * fftSize);
-    fftwPlan = fftwf_plan_dft_1d(fftSize, fft_in, fft_out, FFTW_FORWARD, FFTW_ESTIMATE);
+    {
+        std::lock_guard<std::mutex> lck(dsp::getFFTWPlannerMutex());
+        fftwPlan = fftwf_plan_dft_1d(fftSize, fft_in, fft_out, FFTW_FORWARD, FFTW_ESTIMATE);
+    }
 
+    sigpath::iqFrontEnd.loadFFTWisdom((std::string)core::args["root"] + "/fftw_wisdom", fftThreads);
     sigpath::iqFrontEnd.init(&dummyStream, 8000000, true, 1, false, 1024, 20.0, IQFrontEnd::FFTWindow::NUTTALL, acquireFFTBuffer, releaseFFTBuffer, this);
     sigpath::iqFrontEnd.start();
 
@@ -673,9 +681,33 @@ void MainWindow::draw() {
             ImGui::Checkbox("Show demo window", &demoWindow);
             ImGui::Text("ImGui version: %s", ImGui::GetVersion());
 
-            // ImGui::Checkbox("Bypass buffering", &sigpath::iqFrontEnd.inputBuffer.bypass);
+            // Measuring resident memory isn't free, so only refresh the DSP buffer stats once a second
+            static dsp::buffer::Pool::Stats poolStats;
+            static double lastPoolStats = -1.0;
+            if (lastPoolStats < 0.0 || ImGui::GetTime() - lastPoolStats >= 1.0) {
+                poolStats = dsp::buffer::getPool().getStats();
+                lastPoolStats = ImGui::GetTime();
+            }
+            ImGui::Text("DSP buffers: %.1f MB (%.1f MB resident)", poolStats.liveBytes / 1048576.0, poolStats.residentBytes / 1048576.0);
+            ImGui::Text("DSP buffer cache: %.1f MB", poolStats.cachedBytes / 1048576.0);
+            if (ImGui::Button("Trim buffer cache")) {
+                dsp::buffer::getPool().trim();
+                lastPoolStats = -1.0;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Log buffer report")) {
+                flog::info("{0}", dsp::buffer::getPool().report());
+            }
+
+            ImGui::Text("IQ input overflows: %llu samples", (unsigned long long)sigpath::iqFrontEnd.getInputOverflows());
 
-            // ImGui::Text("Buffering: %d", (sigpath::iqFrontEnd.inputBuffer.writeCur - sigpath::iqFrontEnd.inputBuffer.readCur + 32) % 32);
+            if (dsp::getScheduler().isRunning()) {
+                ImGui::Text("DSP pool: %d threads", dsp::getScheduler().getThreadCount());
+                ImGui::SameLine();
+                if (ImGui::Button("Log block run times")) {
+                    flog::info("{0}", dsp::getScheduler().report());
+                }
+            }
 
             if (ImGui::Button("Test Bug")) {
                 flog::error("Will this make the software crash?");
@@ -38,6 +38,9 @@ namespace displaymenu {
     SDRPP_EXPORT int mpxSmoothingFactor = MPX_DEFAULT_SMOOTHING_FACTOR;
 
     OptionList<int, int> fftSizes;
+    OptionList<int, double> fftOverlaps;
+    bool fftAveraging = false;
+    int fftOverlapId = 0;
     OptionList<float, float> uiScales;
 
     const IQFrontEnd::FFTWindow fftWindowList[] = {
@@ -83,6 +86,11 @@ namespace displaymenu {
         fftSizes.define(2048, "2048", 2048);
         fftSizes.define(1024, "1024", 1024);
 
+        // Compute the best FFT plans for all sizes in the background
+        std::vector<int> sizes;
+        for (int i = 0; i < fftSizes.size(); i++) { sizes.push_back(fftSizes.value(i)); }
+        sigpath::iqFrontEnd.precomputeFFTPlans(sizes);
+
         showWaterfall = core::configManager.conf["showWaterfall"];
         showWaterfall ? gui::waterfall.showWaterfall() : gui::waterfall.hideWaterfall();
         std::string colormapName = core::configManager.conf["colorMap"];
@@ -117,6 +125,18 @@ namespace displaymenu {
         selectedWindow = std::clamp<int>((int)core::configManager.conf["fftWindow"], 0, (sizeof(fftWindowList) / sizeof(IQFrontEnd::FFTWindow)) - 1);
         sigpath::iqFrontEnd.setFFTWindow(fftWindowList[selectedWindow]);
 
+        fftOverlaps.define(0, "0%", 0.0);
+        fftOverlaps.define(25, "25%", 0.25);
+        fftOverlaps.define(50, "50%", 0.5);
+        fftOverlaps.define(75, "75%", 0.75);
+        fftAveraging = core::configManager.conf["fftAveraging"];
+        fftOverlapId = fftOverlaps.valueId(0.5);
+        int overlap = core::configManager.conf["fftOverlap"];
+        if (fftOverlaps.keyExists(overlap)) {
+            fftOverlapId = fftOverlaps.keyId(overlap);
+        }
+        sigpath::iqFrontEnd.setFFTAveraging(fftAveraging, fftOverlaps.value(fftOverlapId));
+
         gui::menu.locked = core::configManager.conf["lockMenuOrder"];
 
         fftHold = core::configManager.conf["fftHold"];
@@ -329,6 +349,24 @@ namespace displaymenu {
             core::configManager.release(true);
         }
 
+        if (ImGui::Checkbox("FFT Averaging##_sdrpp", &fftAveraging)) {
+            sigpath::iqFrontEnd.setFFTAveraging(fftAveraging, fftOverlaps.value(fftOverlapId));
+            core::configManager.acquire();
+            core::configManager.conf["fftAveraging"] = fftAveraging;
+            core::configManager.release(true);
+        }
+
+        if (!fftAveraging) { style::beginDisabled(); }
+        ImGui::LeftLabel("FFT Overlap");
+        ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
+        if (ImGui::Combo("##sdrpp_fft_overlap", &fftOverlapId, fftOverlaps.txt)) {
+            sigpath::iqFrontEnd.setFFTAveraging(fftAveraging, fftOverlaps.value(fftOverlapId));
+            core::configManager.acquire();
+            core::configManager.conf["fftOverlap"] = fftOverlaps.key(fftOverlapId);
+            core::configManager.release(true);
+        }
+        if (!fftAveraging) { style::endDisabled(); }
+
         if (colorMapNames.size() > 0) {
             ImGui::LeftLabel("Color Map");
             ImGui::SetNextItemWidth(menuWidth - ImGui::GetCursorPosX());
@@ -20,6 +20,9 @@ namespace sourcemenu {
 
     bool iqCorrection = false;
     bool invertIQ = false;
+    bool vfoChannelizer = false;
+    int channelCountId = 0;
+    OptionList<int, int> channelCounts;
 
     int offsetId = 0;
     double manualOffset = 0.0;
@@ -167,6 +170,15 @@ namespace sourcemenu {
         decimations.define(32, "32x", 32);
         decimations.define(64, "64x", 64);
 
+        // Define channelizer channel counts
+        channelCounts.define(8, "8", 8);
+        channelCounts.define(16, "16", 16);
+        channelCounts.define(32, "32", 32);
+        channelCounts.define(64, "64", 64);
+        channelCounts.define(128, "128", 128);
+        channelCounts.define(256, "256", 256);
+        channelCountId = channelCounts.keyId(64);
+
         // Acquire the config file
         core::configManager.acquire();
 
@@ -176,6 +188,11 @@ namespace sourcemenu {
         std::string selectedOffset = core::configManager.conf["selectedOffset"];
         iqCorrection = core::configManager.conf["iqCorrection"];
         invertIQ = core::configManager.conf["invertIQ"];
+        vfoChannelizer = core::configManager.conf["vfoChannelizer"];
+        int channels = core::configManager.conf["vfoChannelizerChannels"];
+        if (channelCounts.keyExists(channels)) {
+            channelCountId = channelCounts.keyId(channels);
+        }
         int decimation = core::configManager.conf["decimation"];
         if (decimations.keyExists(decimation)) {
             decimId = decimations.keyId(decimation);
@@ -192,6 +209,7 @@ namespace sourcemenu {
         sigpath::iqFrontEnd.setDCBlocking(iqCorrection);
         sigpath::iqFrontEnd.setInvertIQ(invertIQ);
         sigpath::iqFrontEnd.setDecimation(decimations.value(decimId));
+        sigpath::iqFrontEnd.setChannelizer(vfoChannelizer, channelCounts.value(channelCountId));
         selectOffsetByName(selectedOffset);
 
         // Register handlers
@@ -315,6 +333,24 @@ namespace sourcemenu {
             core::configManager.release(true);
         }
 
+        if (ImGui::Checkbox("VFO Channelizer##_sdrpp_vfo_chan", &vfoChannelizer)) {
+            sigpath::iqFrontEnd.setChannelizer(vfoChannelizer, channelCounts.value(channelCountId));
+            core::configManager.acquire();
+            core::configManager.conf["vfoChannelizer"] = vfoChannelizer;
+            core::configManager.release(true);
+        }
+
+        if (!vfoChannelizer) { style::beginDisabled(); }
+        ImGui::LeftLabel("Channels");
+        ImGui::FillWidth();
+        if (ImGui::Combo("##_sdrpp_vfo_chan_count", &channelCountId, channelCounts.txt)) {
+            sigpath::iqFrontEnd.setChannelizer(vfoChannelizer, channelCounts.value(channelCountId));
+            core::configManager.acquire();
+            core::configManager.conf["vfoChannelizerChannels"] = channelCounts.key(channelCountId);
+            core::configManager.release(true);
+        }
+        if (!vfoChannelizer) { style::endDisabled(); }
+
         ImGui::LeftLabel("Offset mode");
         ImGui::SetNextItemWidth(itemWidth - ImGui::GetCursorPosX() - 2.0f*(lineHeight + 1.5f*spacing));
         if (ImGui::Combo("##_sdrpp_offset", &offsetId, offsets.txt)) {
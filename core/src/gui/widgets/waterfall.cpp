@@ -4,6 +4,7 @@
 #include <imutils.h>
 #include <algorithm>
 #include <volk/volk.h>
+#include <dsp/math/spectrum_reduce.h>
 #include <utils/flog.h>
 #include <gui/gui.h>
 #include <gui/style.h>
@@ -73,22 +74,7 @@ inline void doZoom(int offset, int width, int inSize, int outSize, float* in, fl
         width = 524288;
     }
 
-    float factor = (float)width / (float)outSize;
-    float sFactor = ceilf(factor);
-    float uFactor;
-    float id = offset;
-    float maxVal;
-    int sId;
-    for (int i = 0; i < outSize; i++) {
-        maxVal = -INFINITY;
-        sId = (int)id;
-        uFactor = (sId + sFactor > inSize) ? sFactor - ((sId + sFactor) - inSize) : sFactor;
-        for (int j = 0; j < uFactor; j++) {
-            if (in[sId + j] > maxVal) { maxVal = in[sId + j]; }
-        }
-        out[i] = maxVal;
-        id += factor;
-    }
+    dsp::math::maxPool(in, inSize, offset, width, out, outSize);
 }
 
 namespace ImGui {
@@ -225,16 +211,8 @@ namespace ImGui {
         ImGui::SetCursorPosY(ImGui::GetCursorPosY()+(fftAreaMax.y-fftAreaMin.y) + 17);
         if(ImGui::ImageButton((ImTextureID)autoBtnTextureId, ImVec2(20, 20))) {
             // Get the minimum and maximum amplitude
-            float min = INFINITY;
-            float max = -INFINITY;
-            for (int i = 0; i < dataWidth; i++) {
-                // Get a value
-                const float val = latestFFT[i];
-
-                // Check for extrema
-                if (val < min) { min = val; }
-                if (val > max) { max = val; }
-            }
+            float min, max;
+            dsp::math::rangeMinMax(latestFFT, dataWidth, min, max);
             flog::debug("{} -> {}", min, max);
 
             // Snap to 10dB increments
@@ -252,13 +230,20 @@ namespace ImGui {
     }
 
     void WaterFall::drawWaterfall() {
-        if (waterfallUpdate) {
-            waterfallUpdate = false;
+        if (waterfallUpdate || fbNewRows) {
             updateWaterfallTexture();
         }
         {
+            // The texture is a ring starting at fbTopRow, draw it as two parts with the scroll handled by the texture coordinates
             std::lock_guard<std::mutex> lck(texMtx);
-            window->DrawList->AddImage((void*)(intptr_t)textureId, wfMin, wfMax);
+            float split = (float)(waterfallHeight - fbTopRow);
+            float topV = (float)fbTopRow / (float)waterfallHeight;
+            ImVec2 splitMin = ImVec2(wfMin.x, wfMin.y + split);
+            ImVec2 splitMax = ImVec2(wfMax.x, wfMin.y + split);
+            window->DrawList->AddImage((void*)(intptr_t)textureId, wfMin, splitMax, ImVec2(0, topV), ImVec2(1, 1));
+            if (fbTopRow) {
+                window->DrawList->AddImage((void*)(intptr_t)textureId, splitMin, wfMax, ImVec2(0, 0), ImVec2(1, topV));
+            }
         }
         
         ImVec2 mPos = ImGui::GetMousePos();
@@ -633,9 +618,7 @@ namespace ImGui {
         avg /= (double)(avgCount);
 
         // Calculate max
-        for (int i = vfoMinOffset; i <= vfoMaxOffset; i++) {
-            if (fftLine[i] > max) { max = fftLine[i]; }
-        }
+        max = dsp::math::rangeMax(&fftLine[vfoMinOffset], std::min<int>(vfoMaxOffset, rawFFTSize - 1) - vfoMinOffset + 1);
 
         strength = max;
         snr = max - avg;
@@ -652,18 +635,16 @@ namespace ImGui {
         int drawDataStart;
         // TODO: Maybe put on the stack for faster alloc?
         float* tempData = new float[dataWidth];
-        float pixel;
-        float dataRange = waterfallMax - waterfallMin;
         int count = std::min<float>(waterfallHeight, fftLines);
         if (rawFFTs != NULL && fftLines >= 0) {
+            // Restart the ring from the first row, the whole texture gets uploaded anyway
+            fbTopRow = 0;
+            fbNewRows = 0;
             for (int i = 0; i < count; i++) {
                 drawDataSize = (viewBandwidth / wholeBandwidth) * rawFFTSize;
                 drawDataStart = (((double)rawFFTSize / 2.0) * (offsetRatio + 1)) - (drawDataSize / 2);
                 doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[((i + currentFFTLine) % waterfallHeight) * rawFFTSize], tempData);
-                for (int j = 0; j < dataWidth; j++) {
-                    pixel = (std::clamp<float>(tempData[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
-                    waterfallFb[(i * dataWidth) + j] = waterfallPallet[(int)(pixel * (WATERFALL_RESOLUTION - 1))];
-                }
+                colorizeRow(tempData, &waterfallFb[i * dataWidth]);
             }
 
             for (int i = count; i < waterfallHeight; i++) {
@@ -750,10 +731,36 @@ namespace ImGui {
     void WaterFall::updateWaterfallTexture() {
         std::lock_guard<std::mutex> lck(texMtx);
         glBindTexture(GL_TEXTURE_2D, textureId);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dataWidth, waterfallHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+
+        // Full update, (re)create the texture
+        if (waterfallUpdate) {
+            waterfallUpdate = false;
+            fbNewRows = 0;
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dataWidth, waterfallHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+            return;
+        }
+
+        // Only upload the new rows, in two parts if they wrap around the end of the ring
+        int firstCount = std::min<int>(fbNewRows, waterfallHeight - fbTopRow);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, fbTopRow, dataWidth, firstCount, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)&waterfallFb[fbTopRow * dataWidth]);
+        if (fbNewRows > firstCount) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, dataWidth, fbNewRows - firstCount, GL_RGBA, GL_UNSIGNED_BYTE, (uint8_t*)waterfallFb);
+        }
+        fbNewRows = 0;
+    }
+
+    void WaterFall::colorizeRow(const float* data, uint32_t* out) {
+        // Branchless so that the index computation vectorizes, only the palette lookup is scalar
+        float scale = (float)(WATERFALL_RESOLUTION - 1) / (waterfallMax - waterfallMin);
+        float offset = -waterfallMin * scale;
+        float maxId = (float)(WATERFALL_RESOLUTION - 1);
+        for (int i = 0; i < dataWidth; i++) {
+            float id = std::min<float>(std::max<float>(data[i] * scale + offset, 0.0f), maxId);
+            out[i] = waterfallPallet[(int)id];
+        }
     }
 
     void WaterFall::onPositionChange() {
@@ -827,6 +834,9 @@ namespace ImGui {
             delete[] waterfallFb;
             waterfallFb = new uint32_t[dataWidth * waterfallHeight];
             memset(waterfallFb, 0, dataWidth * waterfallHeight * sizeof(uint32_t));
+            fbTopRow = 0;
+            fbNewRows = 0;
+            waterfallUpdate = true;
         }
         for (int i = 0; i < dataWidth; i++) {
             latestFFT[i] = -1000.0f; // Hide everything
@@ -941,15 +951,10 @@ namespace ImGui {
 
         if (waterfallVisible) {
             doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, &rawFFTs[currentFFTLine * rawFFTSize], latestFFT);
-            memmove(&waterfallFb[dataWidth], waterfallFb, dataWidth * (waterfallHeight - 1) * sizeof(uint32_t));
-            float pixel;
-            float dataRange = waterfallMax - waterfallMin;
-            for (int j = 0; j < dataWidth; j++) {
-                pixel = (std::clamp<float>(latestFFT[j], waterfallMin, waterfallMax) - waterfallMin) / dataRange;
-                int id = (int)(pixel * (WATERFALL_RESOLUTION - 1));
-                waterfallFb[j] = waterfallPallet[id];
-            }
-            waterfallUpdate = true;
+            // Write the new row above the previous newest one instead of scrolling the whole framebuffer
+            fbTopRow = (fbTopRow + waterfallHeight - 1) % waterfallHeight;
+            fbNewRows = std::min<int>(fbNewRows + 1, waterfallHeight);
+            colorizeRow(latestFFT, &waterfallFb[fbTopRow * dataWidth]);
         }
         else {
             doZoom(drawDataStart, drawDataSize, rawFFTSize, dataWidth, rawFFTs, latestFFT);
@@ -1024,16 +1029,8 @@ namespace ImGui {
 
     void WaterFall::autoRange() {
         std::lock_guard<std::recursive_mutex> lck(latestFFTMtx);
-        float min = INFINITY;
-        float max = -INFINITY;
-        for (int i = 0; i < dataWidth; i++) {
-            if (latestFFT[i] < min) {
-                min = latestFFT[i];
-            }
-            if (latestFFT[i] > max) {
-                max = latestFFT[i];
-            }
-        }
+        float min, max;
+        dsp::math::rangeMinMax(latestFFT, dataWidth, min, max);
         fftMin = min - 5;
         fftMax = max + 5;
     }
@@ -231,6 +231,7 @@ namespace ImGui {
         void onResize();
         void updateWaterfallFb();
         void updateWaterfallTexture();
+        void colorizeRow(const float* data, uint32_t* out);
         void updateAllVFOs(bool checkRedrawRequired = false);
         bool calculateVFOSignalInfo(float* fftLine, WaterfallVFO* vfo, float& strength, float& snr);
 
@@ -295,7 +296,10 @@ namespace ImGui {
         int currentFFTLine = 0;
         int fftLines = 0;
 
+        // Ring of waterfall rows, the newest one is at fbTopRow. Only the rows pushed since the last upload are sent to the texture.
         uint32_t* waterfallFb;
+        int fbTopRow = 0;
+        int fbNewRows = 0;
 
         bool draggingFW = false;
         int FFTAreaHeight;
@@ -0,0 +1,151 @@
+#include "fft_plans.h"
+#include <utils/flog.h>
+#include <filesystem>
+#include <algorithm>
+#include <dsp/fftw_planner.h>
+
+FFTPlanCache::~FFTPlanCache() {
+    {
+        std::lock_guard<std::mutex> lck(plansMtx);
+        abort = true;
+    }
+    queueCV.notify_all();
+    if (workerThread.joinable()) { workerThread.join(); }
+    std::lock_guard<std::mutex> lck(dsp::getFFTWPlannerMutex());
+    for (auto& p : allPlans) {
+        fftwf_destroy_plan(p);
+    }
+}
+
+void FFTPlanCache::init(std::string wisdomPath, int threads) {
+    std::lock_guard<std::mutex> lck(dsp::getFFTWPlannerMutex());
+    _wisdomPath = wisdomPath;
+
+#ifdef SDRPP_FFTW_THREADS
+    // Default to half the cores, the FFT competes with the rest of the DSP
+    if (threads <= 0) { threads = std::clamp<int>(std::thread::hardware_concurrency() / 2, 1, 4); }
+    if (threads > 1) {
+        fftwf_init_threads();
+        fftwf_make_planner_thread_safe();
+    }
+    _threads = threads;
+#else
+    _threads = 1;
+#endif
+
+    // Start the measuring thread, it waits for sizes to be requested
+    if (!workerThread.joinable()) { workerThread = std::thread(&FFTPlanCache::worker, this); }
+
+    // Load the wisdom if it exists
+    if (!std::filesystem::exists(_wisdomPath)) { return; }
+    if (!fftwf_import_wisdom_from_filename(_wisdomPath.c_str())) {
+        flog::warn("Could not load FFTW wisdom from '{0}'", _wisdomPath);
+    }
+}
+
+void FFTPlanCache::precompute(std::vector<int> sizes) {
+    // Replace the sizes still waiting, smallest first since they're the fastest to compute
+    std::sort(sizes.begin(), sizes.end());
+    {
+        std::lock_guard<std::mutex> lck(plansMtx);
+        queue.clear();
+    }
+    for (int size : sizes) {
+        if (size <= FFT_PLANS_EAGER_MAX_SIZE) { enqueue(size); }
+    }
+}
+
+fftwf_plan FFTPlanCache::get(int size) {
+    fftwf_plan plan;
+    {
+        std::lock_guard<std::mutex> lck(plansMtx);
+        auto it = plans.find(size);
+        if (it != plans.end()) { return it->second; }
+
+        // Use the wisdom if it's already known, otherwise create an estimated plan right away and measure it later
+        plan = createPlan(size, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+        if (plan) {
+            measured[size] = true;
+        }
+        else {
+            plan = createPlan(size, FFTW_ESTIMATE);
+        }
+        plans[size] = plan;
+        allPlans.push_back(plan);
+        if (measured[size]) { return plan; }
+    }
+    enqueue(size);
+    return plan;
+}
+
+void FFTPlanCache::enqueue(int size) {
+    {
+        std::lock_guard<std::mutex> lck(plansMtx);
+        if (measured[size] || std::find(queue.begin(), queue.end(), size) != queue.end()) { return; }
+        queue.push_back(size);
+    }
+    queueCV.notify_all();
+}
+
+void FFTPlanCache::saveWisdom() {
+    std::lock_guard<std::mutex> lck(dsp::getFFTWPlannerMutex());
+    if (_wisdomPath.empty()) { return; }
+    if (!fftwf_export_wisdom_to_filename(_wisdomPath.c_str())) {
+        flog::warn("Could not save FFTW wisdom to '{0}'", _wisdomPath);
+    }
+}
+
+fftwf_plan FFTPlanCache::createPlan(int size, unsigned int flags) {
+    std::lock_guard<std::mutex> lck(dsp::getFFTWPlannerMutex());
+
+    // Planning with FFTW_MEASURE overwrites the buffers, so plan on scratch buffers
+    fftwf_complex* in = (fftwf_complex*)fftwf_malloc(size * sizeof(fftwf_complex));
+    fftwf_complex* out = (fftwf_complex*)fftwf_malloc(size * sizeof(fftwf_complex));
+
+#ifdef SDRPP_FFTW_THREADS
+    if (_threads > 1) { fftwf_plan_with_nthreads((size >= FFT_PLANS_THREADED_MIN_SIZE) ? _threads : 1); }
+#endif
+    // Bound the measurement so that the lock is never held for long
+    bool measure = (flags & FFTW_MEASURE) && !(flags & FFTW_WISDOM_ONLY);
+    if (measure) { fftwf_set_timelimit(FFT_PLANS_MEASURE_TIME_LIMIT); }
+    fftwf_plan plan = fftwf_plan_dft_1d(size, in, out, FFTW_FORWARD, flags);
+    if (measure) { fftwf_set_timelimit(FFTW_NO_TIMELIMIT); }
+
+    fftwf_free(in);
+    fftwf_free(out);
+    return plan;
+}
+
+void FFTPlanCache::worker() {
+    bool newPlans = false;
+    while (true) {
+        int size;
+        {
+            std::unique_lock<std::mutex> lck(plansMtx);
+
+            // Save the wisdom whenever the queue runs dry so the next start is instant
+            if (queue.empty() && newPlans) {
+                lck.unlock();
+                saveWisdom();
+                newPlans = false;
+                continue;
+            }
+
+            queueCV.wait(lck, [this]() { return abort || !queue.empty(); });
+            if (abort) { return; }
+            size = queue.front();
+            queue.pop_front();
+            if (measured[size]) { continue; }
+        }
+
+        // Measure without holding the cache lock so that the current plans stay available
+        fftwf_plan plan = createPlan(size, FFTW_MEASURE);
+        {
+            std::lock_guard<std::mutex> lck(plansMtx);
+            plans[size] = plan;
+            measured[size] = true;
+            allPlans.push_back(plan);
+        }
+        newPlans = true;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <condition_variable>
+#include <fftw3.h>
+
+// FFT size from which plans are allowed to use multiple threads
+#define FFT_PLANS_THREADED_MIN_SIZE     65536
+
+// Largest size measured as soon as it's listed, larger ones are only measured once actually used
+#define FFT_PLANS_EAGER_MAX_SIZE        65536
+
+// Longest a measurement may hold the planner lock (in seconds), every other plan creation waits on it
+#define FFT_PLANS_MEASURE_TIME_LIMIT    0.05
+
+// Cache of forward FFT plans shared by all FFT sizes of the waterfall. A fast estimated plan is created
+// the first time a size is requested, while measured plans are computed in the background and replace
+// them once ready. Measurements are time limited since the planner lock is shared with the rest of the
+// DSP, including setters called from the GUI. FFTW wisdom is loaded from and saved to disk so that
+// measured plans only need to be computed once. Plans are executed with fftwf_execute_dft() on any pair
+// of buffers allocated with fftwf_malloc().
+class FFTPlanCache {
+public:
+    ~FFTPlanCache();
+
+    // Load the wisdom file and configure threading, a thread count of zero selects it automatically
+    void init(std::string wisdomPath, int threads);
+
+    // Start computing measured plans for the given sizes in the background, up to FFT_PLANS_EAGER_MAX_SIZE
+    void precompute(std::vector<int> sizes);
+
+    // Get the best plan available for a size
+    fftwf_plan get(int size);
+
+    void saveWisdom();
+
+private:
+    fftwf_plan createPlan(int size, unsigned int flags);
+    void enqueue(int size);
+    void worker();
+
+    std::string _wisdomPath;
+    int _threads = 1;
+
+    std::mutex plansMtx;
+    std::map<int, fftwf_plan> plans;
+    std::map<int, bool> measured;
+    std::vector<fftwf_plan> allPlans;
+
+    // Sizes waiting to be measured, protected by plansMtx
+    std::deque<int> queue;
+    std::condition_variable queueCV;
+
+    std::thread workerThread;
+    bool abort = false;
+};
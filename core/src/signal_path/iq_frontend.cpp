@@ -9,7 +9,8 @@ IQFrontEnd::~IQFrontEnd() {
     if (!_init) { return; }
     stop();
     dsp::buffer::free(fftWindowBuf);
-    fftwf_destroy_plan(fftwPlan);
+    dsp::buffer::free(welchAccBuf);
+    dsp::buffer::free(welchPowBuf);
     fftwf_free(fftInBuf);
     fftwf_free(fftOutBuf);
 }
@@ -26,8 +27,8 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 
     effectiveSr = _sampleRate / _decimRatio;
 
-    inBuf.init(in);
-    inBuf.bypass = !buffering;
+    inBuf.init(in, IQ_INPUT_BUFFER_SIZE);
+    inBuf.setBypass(!buffering);
 
     decim.init(NULL, _decimRatio);
     dcBlock.init(NULL, genDCBlockRate(effectiveSr));
@@ -41,10 +42,10 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
     split.init(preproc.out);
 
     // TODO: Do something to avoid basically repeating this code twice
-    int skip;
-    genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
-    reshape.init(&fftIn, fftSize, skip);
-    fftSink.init(&reshape.out, handler, this);
+    int step, frames, skip;
+    genFramingParams(step, frames, skip);
+    framer.init(&fftIn, _nzFFTSize, step, frames, skip);
+    fftSink.init(&framer.out, handler, this);
 
     fftWindowBuf = dsp::buffer::alloc<float>(_nzFFTSize);
     if (_fftWindow == FFTWindow::RECTANGULAR) {
@@ -59,13 +60,20 @@ void IQFrontEnd::init(dsp::stream<dsp::complex_t>* in, double sampleRate, bool b
 
     fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
     fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
 
     // Clear the rest of the FFT input buffer
     dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
 
+    // Welch accumulators
+    welchAccBuf = dsp::buffer::alloc<float>(_fftSize);
+    welchPowBuf = dsp::buffer::alloc<float>(_fftSize);
+    dsp::buffer::clear(welchAccBuf, _fftSize);
+
     split.bindStream(&fftIn);
 
+    // Channelizer, only bound to the splitter when enabled
+    channelizer.init(&chanIn, 64);
+
     _init = true;
 }
 
@@ -85,7 +93,7 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
     effectiveSr = _sampleRate / _decimRatio;
     dcBlock.setRate(genDCBlockRate(effectiveSr));
     for (auto& [name, vfo] : vfos) {
-        vfo->setInSamplerate(effectiveSr);
+        routeVFO(name, true);
     }
 
     // Reconfigure the FFT
@@ -99,7 +107,7 @@ void IQFrontEnd::setSampleRate(double sampleRate) {
 }
 
 void IQFrontEnd::setBuffering(bool enabled) {
-    inBuf.bypass = !enabled;
+    inBuf.setBypass(!enabled);
 }
 
 void IQFrontEnd::setDecimation(int ratio) {
@@ -144,15 +152,21 @@ dsp::channel::RxVFO* IQFrontEnd::addVFO(std::string name, double sampleRate, dou
         return NULL;
     }
 
-    // Create VFO and its input stream
-    dsp::stream<dsp::complex_t>* vfoIn = new dsp::stream<dsp::complex_t>;
+    // Create VFO and its input stream (ring stream so the splitter hands chunks over without locking)
+    dsp::stream<dsp::complex_t>* vfoIn = new dsp::ring_stream<dsp::complex_t>(VFO_INPUT_RING_DEPTH);
     dsp::channel::RxVFO* vfo = new dsp::channel::RxVFO(vfoIn, effectiveSr, sampleRate, bandwidth, offset);
 
     // Register them
     vfoStreams[name] = vfoIn;
     vfos[name] = vfo;
+    vfoOffsets[name] = offset;
+    vfoSamplerates[name] = sampleRate;
+    vfoChannels[name] = -1;
     bindIQStream(vfoIn);
 
+    // Move it to a channelizer channel if possible
+    routeVFO(name, false);
+
     // Start VFO
     vfo->start();
 
@@ -173,15 +187,69 @@ void IQFrontEnd::removeVFO(std::string name) {
     // Stop the VFO
     vfo->stop();
 
-    unbindIQStream(vfoIn);
+    int ch = vfoChannels[name];
+    if (ch < 0) {
+        unbindIQStream(vfoIn);
+    }
+    else {
+        channelizer.unbindStream(ch, vfoIn);
+    }
     vfoStreams.erase(name);
     vfos.erase(name);
+    vfoOffsets.erase(name);
+    vfoSamplerates.erase(name);
+    vfoChannels.erase(name);
 
     // Delete the VFO and its input stream
     delete vfo;
     delete vfoIn;
 }
 
+void IQFrontEnd::setVFOOffset(std::string name, double offset) {
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to tune a VFO that doesn't exist.");
+        return;
+    }
+    vfoOffsets[name] = offset;
+    routeVFO(name, false);
+}
+
+void IQFrontEnd::setVFOSamplerate(std::string name, double sampleRate, double bandwidth) {
+    if (vfos.find(name) == vfos.end()) {
+        flog::error("[IQFrontEnd] Tried to change the samplerate of a VFO that doesn't exist.");
+        return;
+    }
+    vfoSamplerates[name] = sampleRate;
+    vfos[name]->setOutSamplerate(sampleRate, bandwidth);
+    routeVFO(name, false);
+}
+
+void IQFrontEnd::setChannelizer(bool enabled, int channels) {
+    // Move all VFOs back to the full rate splitter
+    bool wasEnabled = channelizerEnabled;
+    channelizerEnabled = false;
+    for (auto& [name, vfo] : vfos) {
+        routeVFO(name, false);
+    }
+
+    // Update the channel count and connect or disconnect the channelizer
+    if (channels != channelizer.getChannelCount()) {
+        channelizer.setChannelCount(channels);
+    }
+    if (enabled && !wasEnabled) {
+        split.bindStream(&chanIn);
+    }
+    else if (!enabled && wasEnabled) {
+        split.unbindStream(&chanIn);
+    }
+    channelizerEnabled = enabled;
+
+    // Move the VFOs that fit in a channel to the channelizer
+    for (auto& [name, vfo] : vfos) {
+        routeVFO(name, false);
+    }
+}
+
 void IQFrontEnd::setFFTSize(int size) {
     _fftSize = size;
     updateFFTPath(true);
@@ -197,10 +265,28 @@ void IQFrontEnd::setFFTWindow(FFTWindow fftWindow) {
     updateFFTPath();
 }
 
+void IQFrontEnd::setFFTAveraging(bool enabled, double overlap) {
+    _fftAveraging = enabled;
+    _fftOverlap = std::clamp<double>(overlap, 0.0, 0.9);
+    updateFFTPath();
+}
+
+void IQFrontEnd::loadFFTWisdom(std::string path, int threads) {
+    fftPlans.init(path, threads);
+}
+
+void IQFrontEnd::precomputeFFTPlans(std::vector<int> sizes) {
+    fftPlans.precompute(sizes);
+}
+
 void IQFrontEnd::flushInputBuffer() {
     inBuf.flush();
 }
 
+uint64_t IQFrontEnd::getInputOverflows() {
+    return inBuf.getOverflows();
+}
+
 void IQFrontEnd::start() {
     // Start input buffer
     inBuf.start();
@@ -211,13 +297,16 @@ void IQFrontEnd::start() {
     // Start IQ splitter
     split.start();
 
+    // Start channelizer
+    channelizer.start();
+
     // Start all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->start();
     }
 
     // Start FFT chain
-    reshape.start();
+    framer.start();
     fftSink.start();
 }
 
@@ -231,13 +320,16 @@ void IQFrontEnd::stop() {
     // Stop IQ splitter
     split.stop();
 
+    // Stop channelizer
+    channelizer.stop();
+
     // Stop all VFOs
     for (auto& [name, vfo] : vfos) {
         vfo->stop();
     }
 
     // Stop FFT chain
-    reshape.stop();
+    framer.stop();
     fftSink.stop();
 }
 
@@ -245,37 +337,133 @@ double IQFrontEnd::getEffectiveSamplerate() {
     return effectiveSr;
 }
 
-void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
-    IQFrontEnd* _this = (IQFrontEnd*)ctx;
+void IQFrontEnd::routeVFO(std::string name, bool force) {
+    dsp::stream<dsp::complex_t>* vfoIn = vfoStreams[name];
+    dsp::channel::RxVFO* vfo = vfos[name];
+    double offset = vfoOffsets[name];
+
+    // Move the VFO input to the producer it should be fed by
+    int oldCh = vfoChannels[name];
+    int ch = selectChannel(offset, vfoSamplerates[name], oldCh);
+    if (ch != oldCh) {
+        // Unbinding only returns once the old producer stopped writing, so the stream never has two writers
+        if (oldCh < 0) {
+            unbindIQStream(vfoIn);
+        }
+        else {
+            channelizer.unbindStream(oldCh, vfoIn);
+        }
+        if (ch < 0) {
+            bindIQStream(vfoIn);
+        }
+        else {
+            channelizer.bindStream(ch, vfoIn);
+        }
+        vfoChannels[name] = ch;
+    }
 
-    // Apply window
-    volk_32fc_32f_multiply_32fc((lv_32fc_t*)_this->fftInBuf, (lv_32fc_t*)data, _this->fftWindowBuf, _this->_nzFFTSize);
+    // Update the VFO input samplerate and make the offset relative to the channel center
+    if (ch != oldCh || force) {
+        vfo->setInSamplerate((ch < 0) ? effectiveSr : (effectiveSr / channelizer.getDecimation()));
+    }
+    vfo->setOffset(offset - channelCenter(ch));
+}
 
-    // Execute FFT
-    fftwf_execute(_this->fftwPlan);
+int IQFrontEnd::selectChannel(double offset, double sampleRate, int current) {
+    if (!channelizerEnabled) { return -1; }
 
-    // Aquire buffer
-    float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
+    // Stay on the current channel for as long as the VFO still fits in it
+    if (current >= 0 && current < channelizer.getChannelCount() && fitsChannel(current, offset, sampleRate, CHANNELIZER_USABLE_RATIO)) {
+        return current;
+    }
+
+    // Find the nearest channel center
+    int channels = channelizer.getChannelCount();
+    double spacing = effectiveSr / (double)channels;
+    int ch = ((int)round(offset / spacing) % channels + channels) % channels;
+
+    // Only move to it if the whole VFO band fits well within the flat part of the channel
+    return fitsChannel(ch, offset, sampleRate, CHANNELIZER_ENTER_RATIO) ? ch : -1;
+}
+
+bool IQFrontEnd::fitsChannel(int channel, double offset, double sampleRate, double ratio) {
+    double spacing = effectiveSr / (double)channelizer.getChannelCount();
+    double rel = offset - channelCenter(channel);
+    return fabs(rel) + (sampleRate / 2.0) <= ratio * spacing;
+}
+
+double IQFrontEnd::channelCenter(int channel) {
+    if (channel < 0) { return 0.0; }
+    int channels = channelizer.getChannelCount();
+    double spacing = effectiveSr / (double)channels;
+    return ((channel < channels / 2) ? channel : (channel - channels)) * spacing;
+}
 
-    // Convert the complex output of the FFT to dB amplitude
-    if (fftBuf) {
-        volk_32fc_s32f_power_spectrum_32f(fftBuf, (lv_32fc_t*)_this->fftOutBuf, _this->_fftSize, _this->_fftSize);
+void IQFrontEnd::handler(dsp::complex_t* data, int count, void* ctx) {
+    IQFrontEnd* _this = (IQFrontEnd*)ctx;
+    int fftSize = _this->_fftSize;
+
+    // The framer always outputs whole frames
+    for (int i = 0; i + _this->_nzFFTSize <= count; i += _this->_nzFFTSize) {
+        // Apply window
+        volk_32fc_32f_multiply_32fc((lv_32fc_t*)_this->fftInBuf, (lv_32fc_t*)&data[i], _this->fftWindowBuf, _this->_nzFFTSize);
+
+        // Execute FFT, the plan is fetched every time since it may have been replaced by a measured one
+        fftwf_execute_dft(_this->fftPlans.get(fftSize), _this->fftInBuf, _this->fftOutBuf);
+
+        // Single frame, convert the complex output of the FFT to dB amplitude directly
+        if (_this->_welchFrames <= 1) {
+            float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
+            if (fftBuf) {
+                volk_32fc_s32f_power_spectrum_32f(fftBuf, (lv_32fc_t*)_this->fftOutBuf, fftSize, fftSize);
+            }
+            _this->_releaseFFTBuffer(_this->_fftCtx);
+            continue;
+        }
+
+        // Welch mode, accumulate the power spectrum of each frame
+        volk_32fc_magnitude_squared_32f(_this->welchPowBuf, (lv_32fc_t*)_this->fftOutBuf, fftSize);
+        volk_32f_x2_add_32f(_this->welchAccBuf, _this->welchAccBuf, _this->welchPowBuf, fftSize);
+        if (++_this->welchCount < _this->_welchFrames) { continue; }
+
+        // Output the average in dB, scaled like the single frame spectrum
+        float* fftBuf = _this->_acquireFFTBuffer(_this->_fftCtx);
+        if (fftBuf) {
+            float scale = 1.0f / ((float)_this->welchCount * (float)fftSize * (float)fftSize);
+            volk_32f_s32f_multiply_32f(fftBuf, _this->welchAccBuf, scale, fftSize);
+            volk_32f_s32f_add_32f(fftBuf, fftBuf, 1e-20f, fftSize);
+            volk_32f_log2_32f(fftBuf, fftBuf, fftSize);
+            volk_32f_s32f_multiply_32f(fftBuf, fftBuf, 10.0f * log10f(2.0f), fftSize);
+        }
+        _this->_releaseFFTBuffer(_this->_fftCtx);
+        dsp::buffer::clear(_this->welchAccBuf, fftSize);
+        _this->welchCount = 0;
     }
+}
 
-    // Release buffer
-    _this->_releaseFFTBuffer(_this->_fftCtx);
+void IQFrontEnd::genFramingParams(int& step, int& frames, int& skip) {
+    int fftInterval = round(effectiveSr / _fftRate);
+    if (_fftAveraging && fftInterval > _fftSize) {
+        _nzFFTSize = _fftSize;
+        genWelchParams(effectiveSr, _fftSize, _fftRate, _fftOverlap, step, frames, skip);
+    }
+    else {
+        genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
+        step = _nzFFTSize;
+        frames = 1;
+    }
+    _welchFrames = frames;
 }
 
 void IQFrontEnd::updateFFTPath(bool updateWaterfall) {
     // Temp stop branch
-    reshape.tempStop();
+    framer.tempStop();
     fftSink.tempStop();
 
-    // Update reshaper settings
-    int skip;
-    genReshapeParams(effectiveSr, _fftSize, _fftRate, skip, _nzFFTSize);
-    reshape.setKeep(_nzFFTSize);
-    reshape.setSkip(skip);
+    // Update framing settings
+    int step, frames, skip;
+    genFramingParams(step, frames, skip);
+    framer.setFraming(_nzFFTSize, step, frames, skip);
 
     // Update window
     dsp::buffer::free(fftWindowBuf);
@@ -290,20 +478,28 @@ void IQFrontEnd::updateFFTPath(bool updateWaterfall) {
         for (int i = 0; i < _nzFFTSize; i++) { fftWindowBuf[i] = dsp::window::nuttall(i, _nzFFTSize) * ((i % 2) ? -1.0f : 1.0f); }
     }
 
-    // Update FFT plan
+    // Update FFT buffers, plans come from the cache
     fftwf_free(fftInBuf);
     fftwf_free(fftOutBuf);
     fftInBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
     fftOutBuf = (fftwf_complex*)fftwf_malloc(_fftSize * sizeof(fftwf_complex));
-    fftwPlan = fftwf_plan_dft_1d(_fftSize, fftInBuf, fftOutBuf, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftPlans.get(_fftSize);
 
     // Clear the rest of the FFT input buffer
     dsp::buffer::clear(fftInBuf, _fftSize - _nzFFTSize, _nzFFTSize);
 
+    // Reset the Welch accumulators
+    dsp::buffer::free(welchAccBuf);
+    dsp::buffer::free(welchPowBuf);
+    welchAccBuf = dsp::buffer::alloc<float>(_fftSize);
+    welchPowBuf = dsp::buffer::alloc<float>(_fftSize);
+    dsp::buffer::clear(welchAccBuf, _fftSize);
+    welchCount = 0;
+
     // Update waterfall (TODO: This is annoying, it makes this module non testable and will constantly clear the waterfall for any reason)
     if (updateWaterfall) { gui::waterfall.setRawFFTSize(_fftSize); }
 
     // Restart branch
-    reshape.tempStart();
+    framer.tempStart();
     fftSink.tempStart();
 }
\ No newline at end of file
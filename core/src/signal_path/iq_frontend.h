@@ -1,15 +1,35 @@
 #pragma once
-#include "../dsp/buffer/frame_buffer.h"
-#include "../dsp/buffer/reshaper.h"
+#include "../dsp/buffer/sample_fifo.h"
+#include "../dsp/buffer/framer.h"
 #include "../dsp/multirate/power_decimator.h"
 #include "../dsp/correction/dc_blocker.h"
 #include "../dsp/chain.h"
 #include "../dsp/routing/splitter.h"
+#include "../dsp/ring_stream.h"
 #include "../dsp/channel/rx_vfo.h"
+#include "../dsp/channel/pfb_channelizer.h"
 #include "../dsp/sink/handler_sink.h"
 #include "../dsp/math/conjugate.h"
+#include "fft_plans.h"
 #include <fftw3.h>
 
+// Capacity in samples of the input buffer absorbing the jitter of the source
+#define IQ_INPUT_BUFFER_SIZE    (4 * STREAM_BUFFER_SIZE)
+
+// Number of chunks that can be in flight between the splitter and each VFO, each slot is a full
+// STREAM_BUFFER_SIZE buffer so this is kept to the two buffers of a regular stream
+#define VFO_INPUT_RING_DEPTH    2
+
+// Maximum number of FFT frames averaged into one spectrum in Welch mode
+#define WELCH_MAX_FRAMES    64
+
+// Fraction of the channel spacing that a VFO can use on each side of a channelizer channel center
+#define CHANNELIZER_USABLE_RATIO    0.75
+
+// Fraction of the channel spacing a VFO must fit in to be moved to a channel, kept below CHANNELIZER_USABLE_RATIO so
+// that a VFO tuned around the limit doesn't keep switching between its channel and the full rate splitter
+#define CHANNELIZER_ENTER_RATIO     0.6
+
 class IQFrontEnd {
 public:
     ~IQFrontEnd();
@@ -36,13 +56,24 @@ public:
 
     dsp::channel::RxVFO* addVFO(std::string name, double sampleRate, double bandwidth, double offset);
     void removeVFO(std::string name);
+    void setVFOOffset(std::string name, double offset);
+    void setVFOSamplerate(std::string name, double sampleRate, double bandwidth);
+
+    void setChannelizer(bool enabled, int channels);
 
     void setFFTSize(int size);
     void setFFTRate(double rate);
     void setFFTWindow(FFTWindow fftWindow);
+    void setFFTAveraging(bool enabled, double overlap);
+
+    void loadFFTWisdom(std::string path, int threads);
+    void precomputeFFTPlans(std::vector<int> sizes);
 
     void flushInputBuffer();
 
+    // Number of input samples dropped because the input buffer was full
+    uint64_t getInputOverflows();
+
     void start();
     void stop();
 
@@ -56,14 +87,29 @@ protected:
         return 50.0 / sampleRate;
     }
 
+    void routeVFO(std::string name, bool force);
+    int selectChannel(double offset, double sampleRate, int current);
+    bool fitsChannel(int channel, double offset, double sampleRate, double ratio);
+    double channelCenter(int channel);
+
     static inline void genReshapeParams(double sampleRate, int size, double rate, int& skip, int& nzSampCount) {
         int fftInterval = round(sampleRate / rate);
         nzSampCount = std::min<int>(fftInterval, size);
         skip = fftInterval - nzSampCount;
     }
 
+    // Welch mode: average overlapping frames covering as much as possible of the interval between two spectra
+    static inline void genWelchParams(double sampleRate, int size, double rate, double overlap, int& step, int& frames, int& skip) {
+        int fftInterval = round(sampleRate / rate);
+        step = std::max<int>(round(size * (1.0 - overlap)), 1);
+        frames = std::clamp<int>(1 + (fftInterval - size) / step, 1, WELCH_MAX_FRAMES);
+        skip = std::max<int>(fftInterval - size - ((frames - 1) * step), 0);
+    }
+
+    void genFramingParams(int& step, int& frames, int& skip);
+
     // Input buffer
-    dsp::buffer::SampleFrameBuffer<dsp::complex_t> inBuf;
+    dsp::buffer::SampleFIFO<dsp::complex_t> inBuf;
 
     // Pre-processing chain
     dsp::multirate::PowerDecimator<dsp::complex_t> decim;
@@ -76,12 +122,20 @@ protected:
 
     // FFT
     dsp::stream<dsp::complex_t> fftIn;
-    dsp::buffer::Reshaper<dsp::complex_t> reshape;
+    dsp::buffer::Framer<dsp::complex_t> framer;
     dsp::sink::Handler<dsp::complex_t> fftSink;
 
+    // Channelizer
+    dsp::stream<dsp::complex_t> chanIn;
+    dsp::channel::PFBChannelizer channelizer;
+    bool channelizerEnabled = false;
+
     // VFOs
     std::map<std::string, dsp::stream<dsp::complex_t>*> vfoStreams;
     std::map<std::string, dsp::channel::RxVFO*> vfos;
+    std::map<std::string, double> vfoOffsets;
+    std::map<std::string, double> vfoSamplerates;
+    std::map<std::string, int> vfoChannels;
 
     // Parameters
     double _sampleRate;
@@ -89,15 +143,21 @@ protected:
     int _fftSize;
     double _fftRate;
     FFTWindow _fftWindow;
+    bool _fftAveraging = false;
+    double _fftOverlap = 0.5;
     float* (*_acquireFFTBuffer)(void* ctx);
     void (*_releaseFFTBuffer)(void* ctx);
     void* _fftCtx;
 
     // Processing data
     int _nzFFTSize;
+    int _welchFrames = 1;
+    int welchCount = 0;
+    float* welchAccBuf = NULL;
+    float* welchPowBuf = NULL;
     float* fftWindowBuf;
     fftwf_complex *fftInBuf, *fftOutBuf;
-    fftwf_plan fftwPlan;
+    FFTPlanCache fftPlans;
     float* fftDbOut;
 
     double effectiveSr;
@@ -0,0 +1,549 @@
+#include "iqz.h"
+#include <volk/volk.h>
+#include <zstd.h>
+#include <stdexcept>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <type_traits>
+#include <dsp/buffer/buffer.h>
+#include <utils/flog.h>
+
+namespace iqz {
+    const char* FILE_MAGIC      = "SDRPPIQZ";
+    const char* CHUNK_MAGIC     = "IQZC";
+    const char* INDEX_MAGIC     = "IQZINDEX";
+    const uint16_t VERSION      = 1;
+    const int MAX_ORDER         = 2;
+
+    const int SAMP_SIZE[] = { sizeof(int8_t), sizeof(int16_t), sizeof(float) };
+
+    // Split the bytes of each value into planes, the high bytes of small values are then mostly identical
+    void shuffle(uint8_t* out, const uint8_t* in, int count, int size) {
+        for (int b = 0; b < size; b++) {
+            uint8_t* plane = &out[b * count];
+            for (int i = 0; i < count; i++) { plane[i] = in[i * size + b]; }
+        }
+    }
+
+    void unshuffle(uint8_t* out, const uint8_t* in, int count, int size) {
+        for (int b = 0; b < size; b++) {
+            const uint8_t* plane = &in[b * count];
+            for (int i = 0; i < count; i++) { out[i * size + b] = plane[i]; }
+        }
+    }
+
+    // Residual of the fixed polynomial predictor of the given order, as in FLAC. The arithmetic wraps around
+    // in the width of T which keeps it lossless without any extra bits.
+    template <class T>
+    inline T residual(const T* x, int i, int stride, int order) {
+        int32_t p0 = x[i];
+        int32_t p1 = (i >= stride) ? x[i - stride] : 0;
+        int32_t p2 = (i >= 2 * stride) ? x[i - 2 * stride] : 0;
+        switch (order) {
+        case 1: return (T)(p0 - p1);
+        case 2: return (T)(p0 - 2 * p1 + p2);
+        default: return (T)p0;
+        }
+    }
+
+    // Map signed residuals to unsigned ones with the small magnitudes first
+    template <class T>
+    inline T zigzag(T v) {
+        using U = std::make_unsigned_t<T>;
+        return (T)(((U)v << 1) ^ (U)(v >> (sizeof(T) * 8 - 1)));
+    }
+
+    template <class T>
+    inline T unzigzag(T v) {
+        using U = std::make_unsigned_t<T>;
+        return (T)(((U)v >> 1) ^ (U)(-(T)((U)v & 1)));
+    }
+
+    // Pick the order giving the smallest residuals and replace the samples by their zigzag coded residuals
+    template <class T>
+    int predict(T* x, int count, int channels) {
+        int64_t sums[MAX_ORDER + 1] = { 0 };
+        for (int i = 0; i < count; i++) {
+            for (int o = 0; o <= MAX_ORDER; o++) { sums[o] += abs((int)residual<T>(x, i, channels, o)); }
+        }
+        int order = std::min_element(sums, sums + MAX_ORDER + 1) - sums;
+
+        // Going backwards keeps the previous samples intact while they're still needed
+        for (int i = count - 1; i >= 0; i--) {
+            x[i] = zigzag<T>(residual<T>(x, i, channels, order));
+        }
+        return order;
+    }
+
+    template <class T>
+    void unpredict(T* x, int count, int channels, int order) {
+        for (int i = 0; i < count; i++) {
+            int32_t r = unzigzag<T>(x[i]);
+            int32_t p1 = (i >= channels) ? x[i - channels] : 0;
+            int32_t p2 = (i >= 2 * channels) ? x[i - 2 * channels] : 0;
+            switch (order) {
+            case 1: x[i] = (T)(r + p1); break;
+            case 2: x[i] = (T)(r + 2 * p1 - p2); break;
+            default: x[i] = (T)r; break;
+            }
+        }
+    }
+
+    Writer::Writer(int channels, uint64_t samplerate, SampleType type, bool predictor) {
+        // Validate channels and samplerate
+        if (channels < 1) { throw std::runtime_error("Channel count must be greater or equal to 1"); }
+        if (channels > IQZ_MAX_CHANNELS) { throw std::runtime_error("Channel count too high"); }
+        if (!samplerate) { throw std::runtime_error("Samplerate must be non-zero"); }
+
+        // Initialize variables
+        _channels = channels;
+        _samplerate = samplerate;
+        _type = type;
+        _predictor = predictor;
+    }
+
+    Writer::~Writer() { close(); }
+
+    bool Writer::open(std::string path) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Close previous file
+        if (_open) { close(); }
+
+        // Reset work values
+        samplesWritten = 0;
+        droppedSamples = 0;
+        droppedBlocks = 0;
+        rawBytes = 0;
+        compressedBytes = 0;
+        framesSubmitted = 0;
+        index.clear();
+
+        // Open file
+        file = std::ofstream(path, std::ios::out | std::ios::binary);
+        if (!file.is_open()) { return false; }
+
+        // Write header
+        FileHeader hdr;
+        memset(&hdr, 0, sizeof(FileHeader));
+        memcpy(hdr.magic, FILE_MAGIC, sizeof(hdr.magic));
+        hdr.version = VERSION;
+        hdr.channelCount = _channels;
+        hdr.sampleType = _type;
+        hdr.flags = (_predictor && _type != SAMP_TYPE_FLOAT32) ? FLAG_PREDICTOR : 0;
+        hdr.sampleRate = _samplerate;
+        hdr.chunkFrames = IQZ_CHUNK_FRAMES;
+        file.write((char*)&hdr, sizeof(FileHeader));
+
+        // Allocate enough jobs to absorb IQZ_BUFFER_TIME of samples, the packing buffers belong to the threads
+        int threads = std::clamp<int>(std::thread::hardware_concurrency(), 1, IQZ_MAX_THREADS);
+        int values = IQZ_CHUNK_FRAMES * _channels;
+        maxPacked = values * SAMP_SIZE[_type];
+        size_t jobBytes = values * sizeof(float) + ZSTD_compressBound(maxPacked);
+        int minJobs = threads * IQZ_CHUNKS_PER_THREAD;
+        int timeJobs = ceil(IQZ_BUFFER_TIME * (double)_samplerate / (double)IQZ_CHUNK_FRAMES);
+        int maxJobs = std::max<int>(IQZ_MAX_BUFFER_BYTES / jobBytes, minJobs);
+        jobs.resize(std::clamp<int>(timeJobs, minJobs, maxJobs));
+        for (auto& job : jobs) {
+            job.raw = dsp::buffer::alloc<float>(values);
+            job.compressed = dsp::buffer::alloc<uint8_t>(ZSTD_compressBound(maxPacked));
+            freeJobs.push_back(&job);
+        }
+        current = NULL;
+
+        // Start the compression threads
+        stopWorkers = false;
+        writing = false;
+        for (int i = 0; i < threads; i++) {
+            workers.push_back(std::thread(&Writer::worker, this));
+        }
+
+        _open = true;
+        return true;
+    }
+
+    bool Writer::isOpen() {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        return _open;
+    }
+
+    void Writer::close() {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do nothing if the file is not open
+        if (!_open) { return; }
+
+        // Submit the partial chunk and let the threads finish the queue
+        if (current && current->frames) { submit(); }
+        {
+            std::lock_guard<std::mutex> lck2(jobMtx);
+            stopWorkers = true;
+        }
+        jobCnd.notify_all();
+        for (auto& t : workers) { t.join(); }
+        workers.clear();
+
+        // Write the index
+        Trailer trailer;
+        trailer.indexOffset = file.tellp();
+        trailer.chunkCount = index.size();
+        memcpy(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic));
+        file.write((char*)index.data(), index.size() * sizeof(IndexEntry));
+        file.write((char*)&trailer, sizeof(Trailer));
+        file.close();
+
+        // Free the jobs
+        for (auto& job : jobs) {
+            dsp::buffer::free(job.raw);
+            dsp::buffer::free(job.compressed);
+        }
+        jobs.clear();
+        freeJobs.clear();
+        todo.clear();
+        pending.clear();
+        current = NULL;
+
+        _open = false;
+    }
+
+    void Writer::setChannels(int channels) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
+
+        // Validate channel count
+        if (channels < 1) { throw std::runtime_error("Channel count must be greater or equal to 1"); }
+        if (channels > IQZ_MAX_CHANNELS) { throw std::runtime_error("Channel count too high"); }
+        _channels = channels;
+    }
+
+    void Writer::setSamplerate(uint64_t samplerate) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
+
+        // Validate samplerate
+        if (!samplerate) { throw std::runtime_error("Samplerate must be non-zero"); }
+        _samplerate = samplerate;
+    }
+
+    void Writer::setSampleType(SampleType type) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        _type = type;
+    }
+
+    void Writer::setPredictor(bool predictor) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        _predictor = predictor;
+    }
+
+    void Writer::setCompressionLevel(int level) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        // Do not allow settings to change while open
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        _level = level;
+    }
+
+    void Writer::write(const float* samples, int count) {
+        std::lock_guard<std::recursive_mutex> lck(mtx);
+        if (!_open) { return; }
+
+        int done = 0;
+        while (done < count) {
+            // Get a new chunk if the current one is full
+            if (!current || current->frames == IQZ_CHUNK_FRAMES) {
+                if (!submit()) {
+                    droppedSamples += count - done;
+                    droppedBlocks++;
+                    break;
+                }
+            }
+
+            // Copy as many samples as fit, the conversion is left to the compression threads
+            int n = std::min<int>(count - done, IQZ_CHUNK_FRAMES - current->frames);
+            memcpy(&current->raw[current->frames * _channels], &samples[done * _channels], n * _channels * sizeof(float));
+            current->frames += n;
+            done += n;
+        }
+
+        // Increment sample counter
+        samplesWritten += done;
+    }
+
+    bool Writer::submit() {
+        std::lock_guard<std::mutex> lck(jobMtx);
+
+        // Queue the current chunk for compression
+        if (current) {
+            current->firstFrame = framesSubmitted;
+            current->done = false;
+            framesSubmitted += current->frames;
+            todo.push_back(current);
+            pending.push_back(current);
+            current = NULL;
+            jobCnd.notify_one();
+        }
+
+        // Take a free chunk without waiting, none being free means compression or the disk is behind
+        if (freeJobs.empty()) { return false; }
+        current = freeJobs.front();
+        freeJobs.pop_front();
+        current->frames = 0;
+        return true;
+    }
+
+    void Writer::compress(Job* job, void* cctx, uint8_t* packed) {
+        int values = job->frames * _channels;
+        ChunkHeader& hdr = job->hdr;
+        memcpy(hdr.magic, CHUNK_MAGIC, sizeof(hdr.magic));
+        memset(hdr.reserved, 0, sizeof(hdr.reserved));
+        hdr.frames = job->frames;
+        hdr.order = 0;
+        hdr.flags = 0;
+        hdr.scale = 1.0f;
+
+        // Quantize to the peak of the chunk
+        uint8_t* quant = &packed[values * SAMP_SIZE[_type]];
+        if (_type != SAMP_TYPE_FLOAT32) {
+            float peak = 0.0f;
+            for (int i = 0; i < values; i++) { peak = std::max<float>(peak, fabsf(job->raw[i])); }
+            float maxVal = (_type == SAMP_TYPE_INT8) ? 127.0f : 32767.0f;
+            hdr.scale = (peak > 0.0f) ? (peak / maxVal) : 1.0f;
+            if (_type == SAMP_TYPE_INT8) {
+                volk_32f_s32f_convert_8i((int8_t*)quant, job->raw, 1.0f / hdr.scale, values);
+                if (_predictor) { hdr.order = predict<int8_t>((int8_t*)quant, values, _channels); }
+            }
+            else {
+                volk_32f_s32f_convert_16i((int16_t*)quant, job->raw, 1.0f / hdr.scale, values);
+                if (_predictor) { hdr.order = predict<int16_t>((int16_t*)quant, values, _channels); }
+            }
+        }
+        else {
+            quant = (uint8_t*)job->raw;
+        }
+
+        // Shuffle and compress
+        size_t size = values * SAMP_SIZE[_type];
+        shuffle(packed, quant, values, SAMP_SIZE[_type]);
+        size_t compSize = ZSTD_compressCCtx((ZSTD_CCtx*)cctx, job->compressed, ZSTD_compressBound(size), packed, size, _level);
+
+        // Store the chunk as is rather than leave a gap in the file, the compression bound is always large enough
+        if (ZSTD_isError(compSize)) {
+            flog::error("Could not compress chunk, storing it uncompressed: {}", ZSTD_getErrorName(compSize));
+            memcpy(job->compressed, packed, size);
+            compSize = size;
+            hdr.flags |= CHUNK_FLAG_STORED;
+        }
+        hdr.compressedSize = compSize;
+    }
+
+    void Writer::writeChunk(Job* job) {
+        index.push_back({ (uint64_t)file.tellp(), job->firstFrame });
+        file.write((char*)&job->hdr, sizeof(ChunkHeader));
+        file.write((char*)job->compressed, job->hdr.compressedSize);
+        rawBytes += job->frames * _channels * SAMP_SIZE[_type];
+        compressedBytes += sizeof(ChunkHeader) + job->hdr.compressedSize;
+    }
+
+    void Writer::worker() {
+        ZSTD_CCtx* cctx = ZSTD_createCCtx();
+        uint8_t* packed = dsp::buffer::alloc<uint8_t>(maxPacked * 2);
+        std::unique_lock<std::mutex> lck(jobMtx);
+        while (true) {
+            jobCnd.wait(lck, [this]() { return !todo.empty() || stopWorkers; });
+            if (todo.empty()) { break; }
+            Job* job = todo.front();
+            todo.pop_front();
+
+            lck.unlock();
+            compress(job, cctx, packed);
+            lck.lock();
+            job->done = true;
+
+            // Write the finished chunks in order, only one thread at a time does it
+            if (writing) { continue; }
+            writing = true;
+            while (!pending.empty() && pending.front()->done) {
+                Job* next = pending.front();
+                pending.pop_front();
+                lck.unlock();
+                writeChunk(next);
+                lck.lock();
+                freeJobs.push_back(next);
+            }
+            writing = false;
+        }
+        dsp::buffer::free(packed);
+        ZSTD_freeCCtx(cctx);
+    }
+
+    Reader::Reader(std::string path) {
+        if (!open(path)) { throw std::runtime_error("Could not open IQZ file"); }
+    }
+
+    Reader::~Reader() {
+        close();
+    }
+
+    bool Reader::open(std::string path) {
+        close();
+        file = std::ifstream(path, std::ios::in | std::ios::binary);
+        if (!file.is_open()) { return false; }
+
+        // Check the header, the chunk size and channel count are bounded since they size the buffers allocated below
+        file.read((char*)&hdr, sizeof(FileHeader));
+        if (file.gcount() != sizeof(FileHeader) || memcmp(hdr.magic, FILE_MAGIC, sizeof(hdr.magic)) || hdr.version != VERSION ||
+            hdr.sampleType > SAMP_TYPE_FLOAT32 || !hdr.channelCount || hdr.channelCount > IQZ_MAX_CHANNELS ||
+            !hdr.chunkFrames || hdr.chunkFrames > IQZ_CHUNK_FRAMES) {
+            file.close();
+            return false;
+        }
+        file.seekg(0, std::ios::end);
+        fileSize = file.tellg();
+
+        // Use the index if the file was closed properly, otherwise go through the chunks
+        if (!loadIndex()) { scanIndex(); }
+
+        // Get the frame count from the last chunk
+        frameCount = 0;
+        if (!index.empty()) {
+            ChunkHeader chdr;
+            file.clear();
+            file.seekg(index.back().offset);
+            file.read((char*)&chdr, sizeof(ChunkHeader));
+            frameCount = index.back().firstFrame + chdr.frames;
+        }
+
+        // Allocate the buffers
+        int values = hdr.chunkFrames * hdr.channelCount;
+        size_t maxPacked = values * SAMP_SIZE[hdr.sampleType];
+        cache.resize(values);
+        packed.resize(maxPacked * 2);
+        compressed.resize(ZSTD_compressBound(maxPacked));
+        dctx = ZSTD_createDCtx();
+        cachedChunk = -1;
+        return true;
+    }
+
+    bool Reader::isOpen() {
+        return file.is_open();
+    }
+
+    void Reader::close() {
+        if (!file.is_open()) { return; }
+        file.close();
+        ZSTD_freeDCtx((ZSTD_DCtx*)dctx);
+        dctx = NULL;
+        index.clear();
+        frameCount = 0;
+    }
+
+    bool Reader::loadIndex() {
+        Trailer trailer;
+        if (fileSize < sizeof(FileHeader) + sizeof(Trailer)) { return false; }
+        file.seekg(fileSize - sizeof(Trailer));
+        file.read((char*)&trailer, sizeof(Trailer));
+        if (memcmp(trailer.magic, INDEX_MAGIC, sizeof(trailer.magic))) { return false; }
+        if (trailer.chunkCount > fileSize / sizeof(IndexEntry)) { return false; }
+        if (trailer.indexOffset + trailer.chunkCount * sizeof(IndexEntry) + sizeof(Trailer) != fileSize) { return false; }
+        index.resize(trailer.chunkCount);
+        file.seekg(trailer.indexOffset);
+        file.read((char*)index.data(), trailer.chunkCount * sizeof(IndexEntry));
+        return true;
+    }
+
+    void Reader::scanIndex() {
+        flog::warn("IQZ file has no index, the recording was probably interrupted. Scanning chunks");
+        index.clear();
+        uint64_t offset = sizeof(FileHeader);
+        uint64_t frame = 0;
+        while (offset + sizeof(ChunkHeader) <= fileSize) {
+            ChunkHeader chdr;
+            file.clear();
+            file.seekg(offset);
+            file.read((char*)&chdr, sizeof(ChunkHeader));
+            if (memcmp(chdr.magic, CHUNK_MAGIC, sizeof(chdr.magic))) { break; }
+
+            // Ignore a chunk that was only partially written
+            if (offset + sizeof(ChunkHeader) + chdr.compressedSize > fileSize) { break; }
+            index.push_back({ offset, frame });
+            frame += chdr.frames;
+            offset += sizeof(ChunkHeader) + chdr.compressedSize;
+        }
+    }
+
+    bool Reader::loadChunk(int id) {
+        if (id == cachedChunk) { return true; }
+        cachedChunk = -1;
+
+        // Read the chunk
+        ChunkHeader chdr;
+        file.clear();
+        file.seekg(index[id].offset);
+        file.read((char*)&chdr, sizeof(ChunkHeader));
+        if (chdr.frames > hdr.chunkFrames || chdr.compressedSize > compressed.size()) { return false; }
+        file.read((char*)compressed.data(), chdr.compressedSize);
+        if (file.gcount() != (std::streamsize)chdr.compressedSize) { return false; }
+
+        // Decompress and unshuffle
+        int values = chdr.frames * hdr.channelCount;
+        int sampSize = SAMP_SIZE[hdr.sampleType];
+        size_t size;
+        if (chdr.flags & CHUNK_FLAG_STORED) {
+            size = std::min<size_t>(chdr.compressedSize, (size_t)values * sampSize);
+            memcpy(packed.data(), compressed.data(), size);
+        }
+        else {
+            size = ZSTD_decompressDCtx((ZSTD_DCtx*)dctx, packed.data(), values * sampSize, compressed.data(), chdr.compressedSize);
+        }
+        if (ZSTD_isError(size) || size != (size_t)values * sampSize) { return false; }
+        uint8_t* quant = &packed[values * sampSize];
+        unshuffle(quant, packed.data(), values, sampSize);
+
+        // Undo the prediction and convert back to float
+        if (hdr.sampleType == SAMP_TYPE_INT8) {
+            if (hdr.flags & FLAG_PREDICTOR) { unpredict<int8_t>((int8_t*)quant, values, hdr.channelCount, chdr.order); }
+            volk_8i_s32f_convert_32f(cache.data(), (int8_t*)quant, 1.0f / chdr.scale, values);
+        }
+        else if (hdr.sampleType == SAMP_TYPE_INT16) {
+            if (hdr.flags & FLAG_PREDICTOR) { unpredict<int16_t>((int16_t*)quant, values, hdr.channelCount, chdr.order); }
+            volk_16i_s32f_convert_32f(cache.data(), (int16_t*)quant, 1.0f / chdr.scale, values);
+        }
+        else {
+            memcpy(cache.data(), quant, values * sizeof(float));
+        }
+
+        cachedChunk = id;
+        cachedFrames = chdr.frames;
+        return true;
+    }
+
+    int Reader::read(float* out, uint64_t pos, int count) {
+        if (!file.is_open()) { return 0; }
+        int done = 0;
+        while (done < count && pos < frameCount) {
+            // Find the chunk containing the position
+            auto it = std::upper_bound(index.begin(), index.end(), pos, [](uint64_t p, const IndexEntry& e) { return p < e.firstFrame; });
+            int id = (it - index.begin()) - 1;
+            if (id < 0 || !loadChunk(id)) {
+                flog::error("Could not read IQZ chunk {}", id);
+                break;
+            }
+
+            // A position past the end of its chunk means frames are missing from the file
+            uint64_t offset = pos - index[id].firstFrame;
+            if (offset >= (uint64_t)cachedFrames) {
+                flog::error("IQZ file is missing frames after chunk {}", id);
+                break;
+            }
+            int n = std::min<int>(count - done, cachedFrames - offset);
+            memcpy(&out[done * hdr.channelCount], &cache[offset * hdr.channelCount], n * hdr.channelCount * sizeof(float));
+            done += n;
+            pos += n;
+        }
+        return done;
+    }
+}
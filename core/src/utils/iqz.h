@@ -0,0 +1,194 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include <stdint.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+// Number of frames per compressed chunk, the seek granularity of the file
+#define IQZ_CHUNK_FRAMES    (1 << 18)
+
+// Highest channel count of a file, bounds the size of a chunk for writers and readers alike
+#define IQZ_MAX_CHANNELS    16
+
+// Maximum number of compression threads, some cores are left to the DSP
+#define IQZ_MAX_THREADS     4
+
+// Minimum number of chunks that can be waiting for compression or for the disk per thread
+#define IQZ_CHUNKS_PER_THREAD   3
+
+// Duration of samples that can be waiting for compression or for the disk before samples get dropped,
+// within a memory budget for high sample rates
+#define IQZ_BUFFER_TIME         1.0
+#define IQZ_MAX_BUFFER_BYTES    (256ull * 1024ull * 1024ull)
+
+// Chunked compressed sample files. Each chunk of IQZ_CHUNK_FRAMES frames is quantized (unless stored as
+// float), optionally run through a fixed linear predictor, byte shuffled and compressed with zstd. An index
+// of the chunks at the end of the file allows seeking, and is rebuilt by scanning if the recording was cut.
+namespace iqz {
+    #pragma pack(push, 1)
+    struct FileHeader {
+        char magic[8];          // "SDRPPIQZ"
+        uint16_t version;
+        uint16_t channelCount;
+        uint16_t sampleType;
+        uint16_t flags;
+        uint64_t sampleRate;
+        uint32_t chunkFrames;
+        uint32_t reserved;
+    };
+
+    struct ChunkHeader {
+        char magic[4];          // "IQZC"
+        uint32_t frames;
+        uint32_t compressedSize;
+        uint8_t order;          // Predictor order used for this chunk
+        uint8_t flags;          // See ChunkFlags
+        uint8_t reserved[2];
+        float scale;            // Value of one quantization step
+    };
+
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t firstFrame;
+    };
+
+    struct Trailer {
+        uint64_t indexOffset;
+        uint64_t chunkCount;
+        char magic[8];          // "IQZINDEX"
+    };
+    #pragma pack(pop)
+
+    enum SampleType {
+        // Quantized to the peak of each chunk, lossy
+        SAMP_TYPE_INT8,
+        SAMP_TYPE_INT16,
+        // Stored as is, lossless
+        SAMP_TYPE_FLOAT32
+    };
+
+    enum Flags {
+        FLAG_PREDICTOR = (1 << 0)
+    };
+
+    enum ChunkFlags {
+        // Shuffled data stored as is because it couldn't be compressed
+        CHUNK_FLAG_STORED = (1 << 0)
+    };
+
+    class Writer {
+    public:
+        Writer(int channels = 2, uint64_t samplerate = 48000, SampleType type = SAMP_TYPE_INT16, bool predictor = true);
+        ~Writer();
+
+        bool open(std::string path);
+        bool isOpen();
+        void close();
+
+        void setChannels(int channels);
+        void setSamplerate(uint64_t samplerate);
+        void setSampleType(SampleType type);
+        void setPredictor(bool predictor);
+        void setCompressionLevel(int level);
+
+        size_t getSamplesWritten() { return samplesWritten; }
+        uint64_t getDroppedSamples() { return droppedSamples; }
+        uint64_t getDroppedBlocks() { return droppedBlocks; }
+
+        // Size of the uncompressed and compressed data written so far, in bytes
+        uint64_t getRawBytes() { return rawBytes; }
+        uint64_t getCompressedBytes() { return compressedBytes; }
+
+        void write(const float* samples, int count);
+
+    private:
+        struct Job {
+            float* raw;
+            uint8_t* compressed;
+            int frames;
+            uint64_t firstFrame;
+            ChunkHeader hdr;
+            bool done;
+        };
+
+        bool submit();
+        void compress(Job* job, void* cctx, uint8_t* packed);
+        void writeChunk(Job* job);
+        void worker();
+
+        std::recursive_mutex mtx;
+        std::ofstream file;
+        bool _open = false;
+
+        int _channels;
+        uint64_t _samplerate;
+        SampleType _type;
+        bool _predictor;
+        int _level = 1;
+        size_t maxPacked;
+
+        // Jobs go from the free list to the calling thread, then to the compression queue. The pending list keeps
+        // them in submission order so that chunks are written in order whichever thread compressed them.
+        std::vector<Job> jobs;
+        std::deque<Job*> freeJobs;
+        std::deque<Job*> todo;
+        std::deque<Job*> pending;
+        std::mutex jobMtx;
+        std::condition_variable jobCnd;
+        bool stopWorkers = false;
+        bool writing = false;
+        std::vector<std::thread> workers;
+        Job* current = NULL;
+
+        std::vector<IndexEntry> index;
+        uint64_t framesSubmitted = 0;
+
+        std::atomic<size_t> samplesWritten = 0;
+        std::atomic<uint64_t> droppedSamples = 0;
+        std::atomic<uint64_t> droppedBlocks = 0;
+        std::atomic<uint64_t> rawBytes = 0;
+        std::atomic<uint64_t> compressedBytes = 0;
+    };
+
+    class Reader {
+    public:
+        Reader() {}
+        Reader(std::string path);
+        ~Reader();
+
+        bool open(std::string path);
+        bool isOpen();
+        void close();
+
+        int getChannelCount() { return hdr.channelCount; }
+        uint64_t getSampleRate() { return hdr.sampleRate; }
+        SampleType getSampleType() { return (SampleType)hdr.sampleType; }
+        uint64_t getFrameCount() { return frameCount; }
+
+        // Read up to 'count' interleaved frames starting at frame 'pos'. Returns the number of frames read.
+        int read(float* out, uint64_t pos, int count);
+
+    private:
+        bool loadIndex();
+        void scanIndex();
+        bool loadChunk(int id);
+
+        std::ifstream file;
+        FileHeader hdr;
+        std::vector<IndexEntry> index;
+        uint64_t frameCount = 0;
+        uint64_t fileSize = 0;
+
+        void* dctx = NULL;
+        int cachedChunk = -1;
+        int cachedFrames = 0;
+        std::vector<float> cache;
+        std::vector<uint8_t> compressed;
+        std::vector<uint8_t> packed;
+    };
+}
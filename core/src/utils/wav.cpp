@@ -4,6 +4,9 @@
 #include <dsp/buffer/buffer.h>
 #include <dsp/stream.h>
 #include <map>
+#include <string.h>
+#include <algorithm>
+#include <math.h>
 
 namespace wav {
     const char* WAVE_FILE_TYPE          = "WAVE";
@@ -29,6 +32,10 @@ namespace wav {
         _samplerate = samplerate;
         _format = format;
         _type = type;
+
+        // The full queue has room for all blocks plus the exit marker so that pushing never waits
+        freeBlocks.init(WAV_WRITER_MIN_BLOCKS);
+        fullBlocks.init(WAV_WRITER_MIN_BLOCKS + 1);
     }
 
     Writer::~Writer() { close(); }
@@ -36,10 +43,12 @@ namespace wav {
     bool Writer::open(std::string path) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Close previous file
-        if (rw.isOpen()) { close(); }
+        if (_open) { close(); }
 
         // Reset work values
         samplesWritten = 0;
+        droppedSamples = 0;
+        droppedBlocks = 0;
 
         // Fill header
         bytesPerSamp = (SAMP_BITS[_type] / 8) * _channels;
@@ -50,24 +59,6 @@ namespace wav {
         hdr.bytesPerSample = bytesPerSamp;
         hdr.bytesPerSecond = bytesPerSamp * _samplerate;
 
-        // Precompute sizes and allocate buffers
-        switch (_type) {
-        case SAMP_TYPE_UINT8:
-            bufU8 = dsp::buffer::alloc<uint8_t>(STREAM_BUFFER_SIZE * _channels);
-            break;
-        case SAMP_TYPE_INT16:
-            bufI16 = dsp::buffer::alloc<int16_t>(STREAM_BUFFER_SIZE * _channels);
-            break;
-        case SAMP_TYPE_INT32:
-            bufI32 = dsp::buffer::alloc<int32_t>(STREAM_BUFFER_SIZE * _channels);
-            break;
-        case SAMP_TYPE_FLOAT32:
-            break;
-        default:
-            return false;
-            break;
-        }
-
         // Open file
         if (!rw.open(path, WAVE_FILE_TYPE)) { return false; }
 
@@ -78,19 +69,43 @@ namespace wav {
 
         // Begin data chunk
         rw.beginChunk(DATA_MARKER);
-        
+
+        // Allocate enough blocks to absorb WAV_WRITER_BUFFER_TIME of samples and start the disk thread
+        int timeBlocks = ceil(WAV_WRITER_BUFFER_TIME * (double)_samplerate * (double)bytesPerSamp / (double)WAV_WRITER_BLOCK_SIZE);
+        int maxBlocks = std::max<int>(WAV_WRITER_MAX_BUFFER_BYTES / WAV_WRITER_BLOCK_SIZE, WAV_WRITER_MIN_BLOCKS);
+        blocks.resize(std::clamp<int>(timeBlocks, WAV_WRITER_MIN_BLOCKS, maxBlocks));
+        freeBlocks.setCapacity(blocks.size());
+        fullBlocks.setCapacity(blocks.size() + 1);
+        for (auto& blk : blocks) {
+            blk.data = (uint8_t*)volk_malloc(WAV_WRITER_BLOCK_SIZE, WAV_WRITER_BLOCK_ALIGN);
+            blk.size = 0;
+            freeBlocks.write(&blk, 1);
+        }
+        current = { NULL, 0 };
+        workerThread = std::thread(&Writer::worker, this);
+
+        _open = true;
         return true;
     }
 
     bool Writer::isOpen() {
-        std::lock_guard<std::recursive_mutex> lck(mtx);
-        return rw.isOpen();
+        return _open;
     }
 
     void Writer::close() {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do nothing if the file is not open
-        if (!rw.isOpen()) { return; }
+        if (!_open) { return; }
+        _open = false;
+
+        // Hand over the partial block and wait for the disk thread to write everything
+        if (current.data) {
+            fullBlocks.write(&current, 1);
+            current = { NULL, 0 };
+        }
+        Block exitMarker = { NULL, 0 };
+        fullBlocks.write(&exitMarker, 1);
+        if (workerThread.joinable()) { workerThread.join(); }
 
         // Finish data chunk
         rw.endChunk();
@@ -98,25 +113,17 @@ namespace wav {
         // Close the file
         rw.close();
 
-        // Free buffers
-        if (bufU8) {
-            dsp::buffer::free(bufU8);
-            bufU8 = NULL;
-        }
-        if (bufI16) {
-            dsp::buffer::free(bufI16);
-            bufI16 = NULL;
-        }
-        if (bufI32) {
-            dsp::buffer::free(bufI32);
-            bufI32 = NULL;
+        // Free blocks
+        for (auto& blk : blocks) {
+            volk_free(blk.data);
         }
+        blocks.clear();
     }
 
     void Writer::setChannels(int channels) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do not allow settings to change while open
-        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
 
         // Validate channel count
         if (channels < 1) { throw std::runtime_error("Channel count must be greater or equal to 1"); }
@@ -126,7 +133,7 @@ namespace wav {
     void Writer::setSamplerate(uint64_t samplerate) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do not allow settings to change while open
-        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
 
         // Validate samplerate
         if (!samplerate) { throw std::runtime_error("Samplerate must be non-zero"); }
@@ -136,48 +143,88 @@ namespace wav {
     void Writer::setFormat(Format format) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do not allow settings to change while open
-        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
         _format = format;
     }
 
     void Writer::setSampleType(SampleType type) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
         // Do not allow settings to change while open
-        if (rw.isOpen()) { throw std::runtime_error("Cannot change parameters while file is open"); }
+        if (_open) { throw std::runtime_error("Cannot change parameters while file is open"); }
         _type = type;
     }
 
     void Writer::write(float* samples, int count) {
         std::lock_guard<std::recursive_mutex> lck(mtx);
-        if (!rw.isOpen()) { return; }
-        
-        // Select different writer function depending on the chose depth
-        int tcount = count * _channels;
-        int tbytes = count * bytesPerSamp;
+        if (!_open) { return; }
+
+        // Blocks only hold whole frames, the end of a block is left unused if the frame size doesn't divide it
+        const int framesPerBlock = WAV_WRITER_BLOCK_SIZE / bytesPerSamp;
+        int done = 0;
+        while (done < count) {
+            // Get a new block if the current one is full
+            if (!current.data || framesPerBlock - (int)(current.size / bytesPerSamp) == 0) {
+                if (!nextBlock()) {
+                    droppedSamples += count - done;
+                    droppedBlocks++;
+                    break;
+                }
+            }
+
+            // Convert as many samples as fit into the block
+            int n = std::min<int>(count - done, framesPerBlock - (current.size / bytesPerSamp));
+            convert(&current.data[current.size], &samples[done * _channels], n * _channels);
+            current.size += n * bytesPerSamp;
+            done += n;
+        }
+
+        // Increment sample counter
+        samplesWritten += done;
+    }
+
+    void Writer::convert(uint8_t* out, const float* in, int count) {
+        // Select different conversion function depending on the chose depth
         switch (_type) {
         case SAMP_TYPE_UINT8:
             // Volk doesn't support unsigned ints yet :/
-            for (int i = 0; i < tcount; i++) {
-                bufU8[i] = (samples[i] * 127.0f) + 128.0f;
+            for (int i = 0; i < count; i++) {
+                out[i] = (in[i] * 127.0f) + 128.0f;
             }
-            rw.write(bufU8, tbytes);
             break;
         case SAMP_TYPE_INT16:
-            volk_32f_s32f_convert_16i(bufI16, samples, 32767.0f, tcount);
-            rw.write((uint8_t*)bufI16, tbytes);
+            volk_32f_s32f_convert_16i((int16_t*)out, in, 32767.0f, count);
             break;
         case SAMP_TYPE_INT32:
-            volk_32f_s32f_convert_32i(bufI32, samples, 2147483647.0f, tcount);
-            rw.write((uint8_t*)bufI32, tbytes);
+            volk_32f_s32f_convert_32i((int32_t*)out, in, 2147483647.0f, count);
             break;
         case SAMP_TYPE_FLOAT32:
-            rw.write((uint8_t*)samples, tbytes);
+            memcpy(out, in, count * sizeof(float));
             break;
         default:
             break;
         }
+    }
 
-        // Increment sample counter
-        samplesWritten += count;
+    bool Writer::nextBlock() {
+        // Queue the full block for the disk thread
+        if (current.data) {
+            fullBlocks.write(&current, 1);
+            current = { NULL, 0 };
+        }
+
+        // Take a free block without waiting, none being free means the disk is behind
+        if (!freeBlocks.available()) { return false; }
+        freeBlocks.read(&current, 1);
+        current.size = 0;
+        return true;
+    }
+
+    void Writer::worker() {
+        Block blk;
+        while (fullBlocks.read(&blk, 1) > 0) {
+            if (!blk.data) { break; }
+            rw.write(blk.data, blk.size);
+            freeBlocks.write(&blk, 1);
+        }
     }
 }
@@ -3,7 +3,21 @@
 #include <fstream>
 #include <stdint.h>
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
 #include "riff.h"
+#include <dsp/buffer/fifo.h>
+
+// Size of the blocks handed to the disk thread, a multiple of the page size for direct IO friendly writes
+#define WAV_WRITER_BLOCK_SIZE   (1 << 20)
+#define WAV_WRITER_BLOCK_ALIGN  4096
+
+// Duration of samples that can be waiting for the disk before samples get dropped, within a memory budget
+// for high sample rates and with a few blocks at least so that the disk thread always has one to work on
+#define WAV_WRITER_BUFFER_TIME      1.0
+#define WAV_WRITER_MAX_BUFFER_BYTES (256ull * 1024ull * 1024ull)
+#define WAV_WRITER_MIN_BLOCKS       4
 
 namespace wav {    
     #pragma pack(push, 1)
@@ -34,6 +48,9 @@ namespace wav {
         CODEC_FLOAT = 3
     };
 
+    // Samples are converted on the calling thread into preallocated blocks that a separate thread writes to
+    // disk, so a slow disk never stalls the DSP. When all blocks are waiting for the disk, the incoming samples
+    // are dropped and counted instead of blocking.
     class Writer {
     public:
         Writer(int channels = 2, uint64_t samplerate = 48000, Format format = FORMAT_WAV, SampleType type = SAMP_TYPE_INT16);
@@ -50,22 +67,44 @@ namespace wav {
 
         size_t getSamplesWritten() { return samplesWritten; }
 
+        // Samples dropped and writes that dropped samples because the disk couldn't keep up, since the file was opened
+        uint64_t getDroppedSamples() { return droppedSamples; }
+        uint64_t getDroppedBlocks() { return droppedBlocks; }
+
         void write(float* samples, int count);
 
     private:
+        void convert(uint8_t* out, const float* in, int count);
+        bool nextBlock();
+        void worker();
+
         std::recursive_mutex mtx;
         FormatHeader hdr;
         riff::Writer rw;
 
+        // Open state kept apart from 'rw' since the disk thread holds its lock during long writes
+        std::atomic<bool> _open = false;
+
         int _channels;
         uint64_t _samplerate;
         Format _format;
         SampleType _type;
         size_t bytesPerSamp;
 
-        uint8_t* bufU8 = NULL;
-        int16_t* bufI16 = NULL;
-        int32_t* bufI32 = NULL;
-        size_t samplesWritten = 0;
+        // Blocks cycle from the free queue to the calling thread, then to the full queue and the disk thread.
+        // A block with a NULL data pointer on the full queue tells the disk thread to exit.
+        struct Block {
+            uint8_t* data;
+            size_t size;
+        };
+        std::vector<Block> blocks;
+        dsp::buffer::FIFO<Block> freeBlocks;
+        dsp::buffer::FIFO<Block> fullBlocks;
+        Block current = { NULL, 0 };
+        std::thread workerThread;
+
+        std::atomic<size_t> samplesWritten = 0;
+        std::atomic<uint64_t> droppedSamples = 0;
+        std::atomic<uint64_t> droppedBlocks = 0;
     };
 }
@@ -22,6 +22,7 @@
 #endif
 #endif
 #include <fftw3.h>
+#include <dsp/fftw_planner.h>
 #ifdef _WIN32
 #ifdef min
 #undef min
@@ -55,7 +56,10 @@ namespace demod {
             
             // Cleanup FFT resources
             if (fftInitialized) {
-                fftwf_destroy_plan(fftPlan);
+                {
+                    std::lock_guard<std::mutex> lck(dsp::getFFTWPlannerMutex());
+                    fftwf_destroy_plan(fftPlan);
+                }
                 fftwf_free(fftInput);
                 fftwf_free(fftOutput);
                 fftInitialized = false;
@@ -308,7 +312,10 @@ namespace demod {
                 } else {
                     mpxHandler.stop();
                     if (fftInitialized) {
-                        fftwf_destroy_plan(fftPlan);
+                        {
+                            std::lock_guard<std::mutex> lck(dsp::getFFTWPlannerMutex());
+                            fftwf_destroy_plan(fftPlan);
+                        }
                         fftwf_free(fftInput);
                         fftwf_free(fftOutput);
                         fftInitialized = false;
@@ -660,7 +667,10 @@ namespace demod {
             // Initialize FFT
             fftInput = (float*)fftwf_malloc(sizeof(float) * FFT_SIZE);
             fftOutput = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * (FFT_SIZE/2 + 1));
-            fftPlan = fftwf_plan_dft_r2c_1d(FFT_SIZE, fftInput, fftOutput, FFTW_ESTIMATE);
+            {
+                std::lock_guard<std::mutex> lck(dsp::getFFTWPlannerMutex());
+                fftPlan = fftwf_plan_dft_r2c_1d(FFT_SIZE, fftInput, fftOutput, FFTW_ESTIMATE);
+            }
             
             if (fftInput && fftOutput && fftPlan) {
                 fftInitialized = true;
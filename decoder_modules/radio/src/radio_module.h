@@ -12,7 +12,7 @@ struct DisabledScope {
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include <config.h>
-#include <dsp/chain.h>
+#include <dsp/fused_chain.h>
 #include <dsp/noise_reduction/noise_blanker.h>
 #include <dsp/noise_reduction/fm_if.h>
 #include <dsp/noise_reduction/squelch.h>
@@ -73,7 +73,7 @@ public:
         onUserChangedBandwidthHandler.ctx = this;
         vfo->wtfVFO->onUserChangedBandwidth.bindHandler(&onUserChangedBandwidthHandler);
 
-        // Initialize IF DSP chain
+        // Initialize IF DSP chain (all IF blocks run fused in a single thread)
         ifChainOutputChanged.ctx = this;
         ifChainOutputChanged.handler = ifChainOutputChangeHandler;
         ifChain.init(vfo->output);
@@ -86,7 +86,7 @@ public:
         ifChain.addBlock(&squelch, false);
         ifChain.addBlock(&fmnr, false);
 
-        // Initialize audio DSP chain
+        // Initialize audio DSP chain (also fused)
         afChain.init(&dummyAudioStream);
 
         resamp.init(NULL, 250000.0, 48000.0);
@@ -98,7 +98,7 @@ public:
         // Initialize the sink
         srChangeHandler.ctx = this;
         srChangeHandler.handler = sampleRateChangeHandler;
-        stream.init(afChain.out, &srChangeHandler, audioSampleRate);
+        stream.init(afChain.getOutput(), &srChangeHandler, audioSampleRate);
         sigpath::sinkManager.registerStream(name, &stream);
 
         // Select the demodulator
@@ -347,7 +347,7 @@ private:
         bw = std::clamp<double>(bw, demod->getMinBandwidth(), demod->getMaxBandwidth());
 
         // Initialize
-        demod->init(name, &config, ifChain.out, bw, stream.getSampleRate());
+        demod->init(name, &config, ifChain.getOutput(), bw, stream.getSampleRate());
 
         return demod;
     }
@@ -383,7 +383,7 @@ private:
         selectedDemod->AFSampRateChanged(audioSampleRate);
 
         // Set the demodulator's input
-        selectedDemod->setInput(ifChain.out);
+        selectedDemod->setInput(ifChain.getOutput());
 
         // Set AF chain's input
         afChain.setInput(selectedDemod->getOutput(), [=](dsp::stream<dsp::stereo_t>* out){ stream.setInput(out); });
@@ -461,7 +461,7 @@ private:
         setBandwidth(bandwidth);
 
         // Configure noise blanker
-        nb.setRate(500.0 / ifSamplerate);
+        ifChain.updateBlock(&nb, [=]() { nb.setRate(500.0 / ifSamplerate); });
         setNBLevel(nbLevel);
         setNBEnabled(nbAllowed && nbEnabled);
 
@@ -535,7 +535,7 @@ private:
         deempId = deempModes.valueId(mode);
         if (!postProcEnabled || !selectedDemod) { return; }
         bool deempEnabled = (mode != DEEMP_MODE_NONE);
-        if (deempEnabled) { deemp.setTau(deempTaus[mode]); }
+        if (deempEnabled) { afChain.updateBlock(&deemp, [=]() { deemp.setTau(deempTaus[mode]); }); }
         afChain.setBlockEnabled(&deemp, deempEnabled, [=](dsp::stream<dsp::stereo_t>* out){ stream.setInput(out); });
 
         // Save config
@@ -557,7 +557,7 @@ private:
 
     void setNBLevel(float level) {
         nbLevel = std::clamp<float>(level, MIN_NB, MAX_NB);
-        nb.setLevel(nbLevel);
+        ifChain.updateBlock(&nb, [=]() { nb.setLevel(nbLevel); });
 
         // Save config
         config.acquire();
@@ -596,7 +596,7 @@ private:
     void setEffectiveSquelchLevel(float level) {
         // Remove mutex lock for now to prevent potential deadlock
         effectiveSquelchLevel = std::clamp<float>(level, MIN_SQUELCH, MAX_SQUELCH);
-        squelch.setLevel(effectiveSquelchLevel);
+        ifChain.updateBlock(&squelch, [=]() { squelch.setLevel(effectiveSquelchLevel); });
     }
     
     // Update effective squelch based on current settings
@@ -632,13 +632,13 @@ private:
         // Don't save if in broadcast mode
         if (preset == IFNR_PRESET_BROADCAST) {
             if (!selectedDemod) { return; }
-            fmnr.setBins(ifnrTaps[preset]);
+            setFMIFNRBins(ifnrTaps[preset]);
             return;
         }
 
         fmIFPresetId = ifnrPresets.valueId(preset);
         if (!selectedDemod) { return; }
-        fmnr.setBins(ifnrTaps[preset]);
+        setFMIFNRBins(ifnrTaps[preset]);
 
         // Save config
         config.acquire();
@@ -715,6 +715,13 @@ private:
         return;
     }
 
+    void setFMIFNRBins(int bins) {
+        // The FM IF NR is processed by the IF chain thread, so it has to be paused while reallocating
+        ifChain.tempStop();
+        fmnr.setBins(bins);
+        ifChain.tempStart();
+    }
+
     // Handlers
     EventHandler<double> onUserChangedBandwidthHandler;
     EventHandler<float> srChangeHandler;
@@ -724,14 +731,14 @@ private:
     VFOManager::VFO* vfo = NULL;
 
     // IF chain
-    dsp::chain<dsp::complex_t> ifChain;
+    dsp::FusedChain<dsp::complex_t, dsp::complex_t> ifChain;
     dsp::noise_reduction::NoiseBlanker nb;
     dsp::noise_reduction::FMIF fmnr;
     dsp::noise_reduction::Squelch squelch;
 
     // Audio chain
     dsp::stream<dsp::stereo_t> dummyAudioStream;
-    dsp::chain<dsp::stereo_t> afChain;
+    dsp::FusedChain<dsp::stereo_t, dsp::stereo_t> afChain;
     dsp::multirate::RationalResampler<dsp::stereo_t> resamp;
     dsp::filter::Deemphasis<dsp::stereo_t> deemp;
 
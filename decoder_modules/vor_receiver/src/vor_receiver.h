@@ -4,7 +4,7 @@
 #include <dsp/demod/quadrature.h>
 #include <dsp/convert/real_to_complex.h>
 #include <dsp/channel/frequency_xlator.h>
-#include <dsp/filter/fir.h>
+#include <dsp/filter/overlap_save_fir.h>
 #include <dsp/math/delay.h>
 #include <dsp/math/conjugate.h>
 #include <dsp/channel/rx_vfo.h>
@@ -97,7 +97,7 @@ namespace vor {
         dsp::convert::RealToComplex fmr2c;
         dsp::channel::FrequencyXlator fmx;
         dsp::tap<float> fmfTaps;
-        dsp::filter::FIR<dsp::complex_t, float> fmf;
+        dsp::filter::OverlapSaveFIR<dsp::complex_t, float> fmf;
         dsp::demod::Quadrature fmd;
         dsp::math::Delay<dsp::complex_t> amde;
         dsp::channel::RxVFO amv;
@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <stddef.h>
+#include <volk/volk.h>
+#include <dsp/buffer/buffer.h>
+
+// Circular history of the last samples received, oldest being overwritten first. The samples are kept as
+// int16, full scale being 1.0, which takes half the memory of floats.
+class HistoryBuffer {
+public:
+    HistoryBuffer() {}
+
+    ~HistoryBuffer() {
+        free();
+    }
+
+    void init(int channels, size_t capacity) {
+        free();
+        _channels = channels;
+        _capacity = std::max<size_t>(capacity, 1);
+        buffer = dsp::buffer::alloc<int16_t>(_capacity * _channels);
+        clear();
+    }
+
+    void free() {
+        if (!buffer) { return; }
+        dsp::buffer::free(buffer);
+        buffer = NULL;
+        _capacity = 0;
+        clear();
+    }
+
+    void clear() {
+        start = 0;
+        count = 0;
+    }
+
+    // Number of frames held
+    size_t size() {
+        return count;
+    }
+
+    size_t getCapacity() {
+        return _capacity;
+    }
+
+    void push(const float* data, int frames) {
+        if (!buffer || frames <= 0) { return; }
+
+        // Only the end of a block larger than the history can be kept
+        size_t n = frames;
+        if (n > _capacity) {
+            data = &data[(n - _capacity) * _channels];
+            n = _capacity;
+        }
+
+        // Convert into the ring, in two parts if it wraps around
+        size_t end = (start + count) % _capacity;
+        size_t first = std::min<size_t>(n, _capacity - end);
+        volk_32f_s32f_convert_16i(&buffer[end * _channels], data, 32767.0f, first * _channels);
+        if (first < n) {
+            volk_32f_s32f_convert_16i(buffer, &data[first * _channels], 32767.0f, (n - first) * _channels);
+        }
+
+        // Drop the oldest frames that were overwritten
+        count += n;
+        if (count > _capacity) {
+            start = (start + count - _capacity) % _capacity;
+            count = _capacity;
+        }
+    }
+
+    // Take out up to 'maxFrames' of the oldest frames. Returns the number of frames taken.
+    int pop(float* data, int maxFrames) {
+        if (maxFrames <= 0) { return 0; }
+        size_t frames = std::min<size_t>(maxFrames, count);
+        if (!frames) { return 0; }
+        size_t first = std::min<size_t>(frames, _capacity - start);
+        volk_16i_s32f_convert_32f(data, &buffer[start * _channels], 32767.0f, first * _channels);
+        if (first < frames) {
+            volk_16i_s32f_convert_32f(&data[first * _channels], buffer, 32767.0f, (frames - first) * _channels);
+        }
+        start = (start + frames) % _capacity;
+        count -= frames;
+        return frames;
+    }
+
+private:
+    int16_t* buffer = NULL;
+    int _channels = 1;
+    size_t _capacity = 0;
+    size_t start = 0;
+    size_t count = 0;
+};
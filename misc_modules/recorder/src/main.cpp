@@ -21,12 +21,29 @@
 #include <core.h>
 #include <utils/optionlist.h>
 #include <utils/wav.h>
+#include <utils/iqz.h>
+#include "history_buffer.h"
 #include <radio_interface.h>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
 #define SILENCE_LVL 10e-6
 
+// Longest pre-trigger history that can be configured, in seconds
+#define MAX_PRE_TRIGGER     30.0f
+
+// Memory the pre-trigger history may use, longer histories are shortened to fit
+#define MAX_PRE_TRIGGER_BYTES   (512ull * 1024ull * 1024ull)
+
+// How much faster than realtime the pre-trigger history is written out once recording starts
+#define HISTORY_DRAIN_RATIO 4
+
+enum Container {
+    CONTAINER_WAV,
+    CONTAINER_RF64,
+    CONTAINER_IQZ
+};
+
 SDRPP_MOD_INFO{
     /* Name:            */ "recorder",
     /* Description:     */ "Recorder module for SDR++",
@@ -45,16 +62,21 @@ public:
         strcpy(nameTemplate, "$t_$f_$h-$m-$s_$d-$M-$y");
 
         // Define option lists
-        containers.define("WAV", wav::FORMAT_WAV);
-        // containers.define("RF64", wav::FORMAT_RF64); // Disabled for now
+        containers.define("WAV", CONTAINER_WAV);
+        // containers.define("RF64", CONTAINER_RF64); // Disabled for now
+        containers.define("IQZ", "IQZ (compressed)", CONTAINER_IQZ);
         sampleTypes.define(wav::SAMP_TYPE_UINT8, "Uint8", wav::SAMP_TYPE_UINT8);
         sampleTypes.define(wav::SAMP_TYPE_INT16, "Int16", wav::SAMP_TYPE_INT16);
         sampleTypes.define(wav::SAMP_TYPE_INT32, "Int32", wav::SAMP_TYPE_INT32);
         sampleTypes.define(wav::SAMP_TYPE_FLOAT32, "Float32", wav::SAMP_TYPE_FLOAT32);
+        compressions.define("lossless", "Lossless (Float32)", iqz::SAMP_TYPE_FLOAT32);
+        compressions.define("int16", "Int16 (per chunk scaling)", iqz::SAMP_TYPE_INT16);
+        compressions.define("int8", "Int8 (per chunk scaling)", iqz::SAMP_TYPE_INT8);
 
         // Load default config for option lists
-        containerId = containers.valueId(wav::FORMAT_WAV);
+        containerId = containers.valueId(CONTAINER_WAV);
         sampleTypeId = sampleTypes.valueId(wav::SAMP_TYPE_INT16);
+        compressionId = compressions.valueId(iqz::SAMP_TYPE_INT16);
 
         // Load config
         config.acquire();
@@ -70,6 +92,18 @@ public:
         if (config.conf[name].contains("sampleType") && sampleTypes.keyExists(config.conf[name]["sampleType"])) {
             sampleTypeId = sampleTypes.keyId(config.conf[name]["sampleType"]);
         }
+        if (config.conf[name].contains("compression") && compressions.keyExists(config.conf[name]["compression"])) {
+            compressionId = compressions.keyId(config.conf[name]["compression"]);
+        }
+        if (config.conf[name].contains("predictor")) {
+            predictor = config.conf[name]["predictor"];
+        }
+        if (config.conf[name].contains("compressionLevel")) {
+            compressionLevel = std::clamp<int>(config.conf[name]["compressionLevel"], 1, 19);
+        }
+        if (config.conf[name].contains("preTrigger")) {
+            preTrigger = config.conf[name]["preTrigger"];
+        }
         if (config.conf[name].contains("audioStream")) {
             selectedStreamName = config.conf[name]["audioStream"];
         }
@@ -98,6 +132,9 @@ public:
         meter.init(&meterStream);
         s2m.init(&stereoStream);
 
+        // Scratch buffer used to write out the history
+        historyBuf = dsp::buffer::alloc<float>(STREAM_BUFFER_SIZE * 2);
+
         // Init sinks
         basebandSink.init(NULL, complexHandler, this);
         stereoSink.init(&stereoStream, stereoHandler, this);
@@ -111,11 +148,14 @@ public:
         std::lock_guard<std::recursive_mutex> lck(recMtx);
         core::modComManager.unregisterInterface(name);
         gui::menu.removeEntry(name);
+        preTrigger = 0.0f;
         stop();
+        updatePreTrigger();
         deselectStream();
         sigpath::sinkManager.onStreamRegistered.unbindHandler(&onStreamRegisteredHandler);
         sigpath::sinkManager.onStreamUnregister.unbindHandler(&onStreamUnregisterHandler);
         meter.stop();
+        dsp::buffer::free(historyBuf);
     }
 
     void postInit() {
@@ -136,6 +176,9 @@ public:
 
         // Select the stream
         selectStream(selectedStreamName);
+
+        // Start keeping the history if enabled
+        updatePreTrigger();
     }
 
     void enable() {
@@ -162,10 +205,21 @@ public:
         else {
             samplerate = sigpath::iqFrontEnd.getSampleRate();
         }
-        writer.setFormat(containers[containerId]);
-        writer.setChannels((recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2);
-        writer.setSampleType(sampleTypes[sampleTypeId]);
-        writer.setSamplerate(samplerate);
+        int channels = (recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2;
+        compressed = (containers[containerId] == CONTAINER_IQZ);
+        if (compressed) {
+            iqzWriter.setChannels(channels);
+            iqzWriter.setSampleType(compressions[compressionId]);
+            iqzWriter.setPredictor(predictor);
+            iqzWriter.setCompressionLevel(compressionLevel);
+            iqzWriter.setSamplerate(samplerate);
+        }
+        else {
+            writer.setFormat(wav::FORMAT_WAV);
+            writer.setChannels(channels);
+            writer.setSampleType(sampleTypes[sampleTypeId]);
+            writer.setSamplerate(samplerate);
+        }
 
         // Open file
         std::string expandedPath;
@@ -175,15 +229,62 @@ public:
         } else {
             // Use normal filename generation
             std::string vfoName = (recMode == RECORDER_MODE_AUDIO) ? selectedStreamName : "";
-            std::string extension = ".wav";
+            std::string extension = compressed ? ".iqz" : ".wav";
             expandedPath = expandString(folderSelect.path + "/" + genFileName(nameTemplate, recMode, vfoName) + extension);
         }
-        if (!writer.open(expandedPath)) {
+        if (!(compressed ? iqzWriter.open(expandedPath) : writer.open(expandedPath))) {
             flog::error("Failed to open file for recording: {0}", expandedPath);
             return;
         }
 
-        // Open audio stream or baseband
+        // The history is only usable if it was kept with the same settings
+        bool matches = (pathMode == recMode) && (recMode == RECORDER_MODE_BASEBAND || pathStereo == stereo) && (historyRate == samplerate);
+        if (pathRunning && !matches) { stopPath(); }
+        {
+            std::lock_guard<std::mutex> hlck(historyMtx);
+            if (!matches) { history.clear(); }
+            recording = true;
+        }
+
+        // Open audio stream or baseband, unless already open for the history
+        if (!pathRunning) { startPath(); }
+    }
+
+    void stop() {
+        std::lock_guard<std::recursive_mutex> lck(recMtx);
+        if (!recording) { return; }
+        {
+            std::lock_guard<std::mutex> hlck(historyMtx);
+            recording = false;
+        }
+
+        // Close audio stream or baseband
+        stopPath();
+
+        // Close file
+        if (compressed) {
+            iqzWriter.close();
+        }
+        else {
+            writer.close();
+        }
+        
+        // Reset external control state
+        if (externalControl) {
+            externalControl = false;
+            externalFilename = "";
+            externalController = "";
+        }
+
+        // Go back to keeping the history
+        updatePreTrigger();
+    }
+
+    // Start the path feeding the handlers, used while recording and while keeping the pre-trigger history
+    void startPath() {
+        if (pathRunning) { return; }
+        pathMode = recMode;
+        pathStereo = stereo;
         if (recMode == RECORDER_MODE_AUDIO) {
             // Start correct path depending on 
             if (stereo) {
@@ -202,21 +303,16 @@ public:
             basebandSink.start();
             sigpath::iqFrontEnd.bindIQStream(basebandStream);
         }
-
-        recording = true;
+        pathRunning = true;
     }
 
-    void stop() {
-        std::lock_guard<std::recursive_mutex> lck(recMtx);
-        if (!recording) { return; }
-
-        // Close audio stream or baseband
-        if (recMode == RECORDER_MODE_AUDIO) {
+    void stopPath() {
+        if (!pathRunning) { return; }
+        if (pathMode == RECORDER_MODE_AUDIO) {
             splitter.unbindStream(&stereoStream);
             monoSink.stop();
             stereoSink.stop();
             s2m.stop();
-            
         }
         else {
             // Unbind and destroy IQ stream
@@ -224,18 +320,40 @@ public:
             basebandSink.stop();
             delete basebandStream;
         }
+        pathRunning = false;
+    }
 
-        // Close file
-        writer.close();
-        
-        // Reset external control state
-        if (externalControl) {
-            externalControl = false;
-            externalFilename = "";
-            externalController = "";
+    // Keep the last seconds of samples in memory when the pre-trigger is enabled so that they can be written
+    // at the start of the next recording. Called whenever a setting affecting the samples changes.
+    void updatePreTrigger() {
+        std::lock_guard<std::recursive_mutex> lck(recMtx);
+        // Applied once the recording stops
+        if (recording) { return; }
+
+        // Restart the path so that the new settings are used
+        stopPath();
+        bool enable = (preTrigger > 0.0f) && (recMode == RECORDER_MODE_BASEBAND || !selectedStreamName.empty());
+        if (!enable) {
+            history.free();
+            return;
         }
-        
-        recording = false;
+
+        // Allocate the history for the current sample rate, within the memory budget
+        historyRate = (recMode == RECORDER_MODE_AUDIO) ? sigpath::sinkManager.getStreamSampleRate(selectedStreamName) : sigpath::iqFrontEnd.getSampleRate();
+        if (!historyRate) {
+            history.free();
+            return;
+        }
+        int channels = (recMode == RECORDER_MODE_AUDIO && !stereo) ? 1 : 2;
+        double frames = (double)preTrigger * (double)historyRate;
+        double maxFrames = (double)(MAX_PRE_TRIGGER_BYTES / (channels * sizeof(int16_t)));
+        if (frames > maxFrames) {
+            frames = maxFrames;
+            flog::warn("Pre-trigger history limited to {0}s by its memory budget", (int)(frames / (double)historyRate));
+        }
+        history.init(channels, (size_t)frames);
+        historyTime = frames / (double)historyRate;
+        startPath();
     }
 
 private:
@@ -249,6 +367,7 @@ private:
         ImGui::Columns(2, CONCAT("RecorderModeColumns##_", _this->name), false);
         if (ImGui::RadioButton(CONCAT("Baseband##_recorder_mode_", _this->name), _this->recMode == RECORDER_MODE_BASEBAND)) {
             _this->recMode = RECORDER_MODE_BASEBAND;
+            _this->updatePreTrigger();
             config.acquire();
             config.conf[_this->name]["mode"] = _this->recMode;
             config.release(true);
@@ -256,6 +375,7 @@ private:
         ImGui::NextColumn();
         if (ImGui::RadioButton(CONCAT("Audio##_recorder_mode_", _this->name), _this->recMode == RECORDER_MODE_AUDIO)) {
             _this->recMode = RECORDER_MODE_AUDIO;
+            _this->updatePreTrigger();
             config.acquire();
             config.conf[_this->name]["mode"] = _this->recMode;
             config.release(true);
@@ -288,13 +408,58 @@ private:
             config.release(true);
         }
 
-        ImGui::LeftLabel("Sample type");
+        if (_this->containers[_this->containerId] == CONTAINER_IQZ) {
+            ImGui::LeftLabel("Compression");
+            ImGui::FillWidth();
+            if (ImGui::Combo(CONCAT("##_recorder_comp_", _this->name), &_this->compressionId, _this->compressions.txt)) {
+                config.acquire();
+                config.conf[_this->name]["compression"] = _this->compressions.key(_this->compressionId);
+                config.release(true);
+            }
+
+            // Higher levels compress better but may not keep up with high sample rates
+            ImGui::LeftLabel("Level");
+            ImGui::FillWidth();
+            if (ImGui::SliderInt(CONCAT("##_recorder_level_", _this->name), &_this->compressionLevel, 1, 19)) {
+                config.acquire();
+                config.conf[_this->name]["compressionLevel"] = _this->compressionLevel;
+                config.release(true);
+            }
+
+            // The predictor only applies to integer samples
+            if (_this->compressions[_this->compressionId] != iqz::SAMP_TYPE_FLOAT32) {
+                if (ImGui::Checkbox(CONCAT("Predictor##_recorder_pred_", _this->name), &_this->predictor)) {
+                    config.acquire();
+                    config.conf[_this->name]["predictor"] = _this->predictor;
+                    config.release(true);
+                }
+            }
+        }
+        else {
+            ImGui::LeftLabel("Sample type");
+            ImGui::FillWidth();
+            if (ImGui::Combo(CONCAT("##_recorder_st_", _this->name), &_this->sampleTypeId, _this->sampleTypes.txt)) {
+                config.acquire();
+                config.conf[_this->name]["sampleType"] = _this->sampleTypes.key(_this->sampleTypeId);
+                config.release(true);
+            }
+        }
+
+        // Seconds kept in memory and written at the start of each recording
+        ImGui::LeftLabel("Pre-trigger");
         ImGui::FillWidth();
-        if (ImGui::Combo(CONCAT("##_recorder_st_", _this->name), &_this->sampleTypeId, _this->sampleTypes.txt)) {
+        ImGui::SliderFloat(CONCAT("##_recorder_pretrig_", _this->name), &_this->preTrigger, 0.0f, MAX_PRE_TRIGGER, _this->preTrigger > 0.0f ? "%.1fs" : "Off");
+
+        // Reallocating the history is expensive, only do it once the slider is released
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+            _this->updatePreTrigger();
             config.acquire();
-            config.conf[_this->name]["sampleType"] = _this->sampleTypes.key(_this->sampleTypeId);
+            config.conf[_this->name]["preTrigger"] = _this->preTrigger;
             config.release(true);
         }
+        if (_this->history.getCapacity() && _this->historyTime < _this->preTrigger - 0.05f) {
+            ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Limited to %.1fs by memory", _this->historyTime);
+        }
 
         if (_this->recording) { style::endDisabled(); }
 
@@ -327,6 +492,7 @@ private:
 
             if (_this->recording) { style::beginDisabled(); }
             if (ImGui::Checkbox(CONCAT("Stereo##_recorder_stereo_", _this->name), &_this->stereo)) {
+                _this->updatePreTrigger();
                 config.acquire();
                 config.conf[_this->name]["stereo"] = _this->stereo;
                 config.release(true);
@@ -364,7 +530,7 @@ private:
             if (ImGui::Button(CONCAT("Stop##_recorder_rec_", _this->name), ImVec2(menuWidth, 0))) {
                 _this->stop();
             }
-            uint64_t seconds = _this->writer.getSamplesWritten() / _this->samplerate;
+            uint64_t seconds = _this->getSamplesWritten() / _this->samplerate;
             time_t diff = seconds;
             tm* dtm = gmtime(&diff);
 
@@ -378,6 +544,19 @@ private:
                     ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Recording %02d:%02d:%02d", dtm->tm_hour, dtm->tm_min, dtm->tm_sec);
                 }
             }
+
+            // Size of the compressed data relative to the samples it holds
+            if (_this->compressed && _this->iqzWriter.getRawBytes()) {
+                double ratio = (double)_this->iqzWriter.getCompressedBytes() / (double)_this->iqzWriter.getRawBytes();
+                ImGui::Text("Compressed to %.1f%%", ratio * 100.0);
+            }
+
+            // Samples dropped because the disk (or the compression) couldn't keep up
+            uint64_t droppedBlocks = _this->compressed ? _this->iqzWriter.getDroppedBlocks() : _this->writer.getDroppedBlocks();
+            if (droppedBlocks) {
+                double droppedSec = (double)(_this->compressed ? _this->iqzWriter.getDroppedSamples() : _this->writer.getDroppedSamples()) / _this->samplerate;
+                ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Dropped %llu blocks (%.2fs)", (unsigned long long)droppedBlocks, droppedSec);
+            }
         }
         
         // End disabled section for external control
@@ -405,6 +584,7 @@ private:
         streamId = audioStreams.keyId(name);
         volume.setInput(audioStream);
         startAudioPath();
+        updatePreTrigger();
     }
 
     void deselectStream() {
@@ -414,6 +594,7 @@ private:
             return;
         }
         if (recording && recMode == RECORDER_MODE_AUDIO) { stop(); }
+        if (pathMode == RECORDER_MODE_AUDIO) { stopPath(); }
         stopAudioPath();
         sigpath::sinkManager.unbindStream(selectedStreamName, audioStream);
         selectedStreamName.clear();
@@ -540,12 +721,12 @@ private:
 
     static void complexHandler(dsp::complex_t* data, int count, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
-        _this->writer.write((float*)data, count);
+        _this->handleSamples((float*)data, count);
     }
 
     static void stereoHandler(dsp::stereo_t* data, int count, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
-        if (_this->ignoreSilence) {
+        if (_this->ignoreSilence && _this->recording) {
             float absMax = 0.0f;
             float* _data = (float*)data;
             int _count = count * 2;
@@ -556,12 +737,12 @@ private:
             _this->ignoringSilence = (absMax < SILENCE_LVL);
             if (_this->ignoringSilence) { return; }
         }
-        _this->writer.write((float*)data, count);
+        _this->handleSamples((float*)data, count);
     }
 
     static void monoHandler(float* data, int count, void* ctx) {
         RecorderModule* _this = (RecorderModule*)ctx;
-        if (_this->ignoreSilence) {
+        if (_this->ignoreSilence && _this->recording) {
             float absMax = 0.0f;
             for (int i = 0; i < count; i++) {
                 float val = fabsf(data[i]);
@@ -570,7 +751,51 @@ private:
             _this->ignoringSilence = (absMax < SILENCE_LVL);
             if (_this->ignoringSilence) { return; }
         }
-        _this->writer.write(data, count);
+        _this->handleSamples(data, count);
+    }
+
+    // Write the samples while recording, keep them in the history otherwise
+    void handleSamples(float* data, int count) {
+        std::lock_guard<std::mutex> lck(historyMtx);
+        if (!recording) {
+            history.push(data, count);
+            return;
+        }
+        if (!history.size()) {
+            writeSamples(data, count);
+            return;
+        }
+
+        // Write the history ahead of the live samples, a little faster than realtime so as not to flood the writer,
+        // but always enough to make room for the live samples since pushing into a full history drops recorded frames
+        size_t room = history.getCapacity() - history.size();
+        int left = std::max<int>(count * HISTORY_DRAIN_RATIO, ((size_t)count > room) ? (int)(count - room) : 0);
+        while (left > 0 && history.size()) {
+            int n = history.pop(historyBuf, std::min<int>(left, STREAM_BUFFER_SIZE));
+            writeSamples(historyBuf, n);
+            left -= n;
+        }
+
+        // Queue the live samples behind what's left of the history, or write them right away once it's empty
+        if (history.size()) {
+            history.push(data, count);
+        }
+        else {
+            writeSamples(data, count);
+        }
+    }
+
+    void writeSamples(float* data, int count) {
+        if (compressed) {
+            iqzWriter.write(data, count);
+        }
+        else {
+            writer.write(data, count);
+        }
+    }
+
+    size_t getSamplesWritten() {
+        return compressed ? iqzWriter.getSamplesWritten() : writer.getSamplesWritten();
     }
 
     static void moduleInterfaceHandler(int code, void* in, void* out, void* ctx) {
@@ -583,7 +808,10 @@ private:
         else if (code == RECORDER_IFACE_CMD_SET_MODE) {
             if (_this->recording) { return; }
             int* _in = (int*)in;
-            _this->recMode = std::clamp<int>(*_in, 0, 1);
+            int mode = std::clamp<int>(*_in, 0, 1);
+            if (mode == _this->recMode) { return; }
+            _this->recMode = mode;
+            _this->updatePreTrigger();
         }
         else if (code == RECORDER_IFACE_CMD_START) {
             if (!_this->recording) { _this->start(); }
@@ -625,13 +853,17 @@ private:
     std::string root;
     char nameTemplate[1024];
 
-    OptionList<std::string, wav::Format> containers;
+    OptionList<std::string, Container> containers;
     OptionList<int, wav::SampleType> sampleTypes;
+    OptionList<std::string, iqz::SampleType> compressions;
     FolderSelect folderSelect;
 
     int recMode = RECORDER_MODE_AUDIO;
     int containerId;
     int sampleTypeId;
+    int compressionId;
+    int compressionLevel = 1;
+    bool predictor = true;
     bool stereo = true;
     std::string selectedStreamName = "";
     float audioVolume = 1.0f;
@@ -641,6 +873,19 @@ private:
     bool recording = false;
     bool ignoringSilence = false;
     wav::Writer writer;
+    iqz::Writer iqzWriter;
+    bool compressed = false;
+
+    // Pre-trigger history, the path is kept running while it's enabled
+    float preTrigger = 0.0f;
+    HistoryBuffer history;
+    std::mutex historyMtx;
+    float* historyBuf;
+    uint64_t historyRate = 0;
+    float historyTime = 0.0f;
+    bool pathRunning = false;
+    int pathMode = RECORDER_MODE_AUDIO;
+    bool pathStereo = true;
     std::recursive_mutex recMtx;
     dsp::stream<dsp::complex_t>* basebandStream;
     dsp::stream<dsp::stereo_t> stereoStream;
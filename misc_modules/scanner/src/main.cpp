@@ -17,6 +17,7 @@
 #include "scanner_log.h" // Custom logging macros
 #include "../Logger.hpp"
 #include <gui/widgets/precision_slider.h>
+#include <dsp/math/spectrum_reduce.h>
 #include <gui/widgets/folder_select.h>
 #include <gui/file_dialogs.h>
 #include <filesystem>
@@ -2130,22 +2131,7 @@ private:
                 processedFFT.resize(dataWidth);
                 
                 // Simple peak detection: decimate rawFFTSize to dataWidth
-                float factor = (float)rawFFTSize / (float)dataWidth;
-                
-                for (int i = 0; i < dataWidth; i++) {
-                    float maxVal = -INFINITY;
-                    int startIdx = (int)(i * factor);
-                    int endIdx = (int)((i + 1) * factor);
-                    if (endIdx > rawFFTSize) endIdx = rawFFTSize;
-                    
-                    // Find peak in this group
-                    for (int j = startIdx; j < endIdx; j++) {
-                        if (rawFFTCopy[j] > maxVal) { 
-                            maxVal = rawFFTCopy[j]; 
-                        }
-                    }
-                    processedFFT[i] = maxVal;
-                }
+                dsp::math::maxPool(rawFFTCopy.data(), rawFFTSize, 0, rawFFTSize, processedFFT.data(), dataWidth);
                 
 
                 
@@ -3168,12 +3154,7 @@ private:
         int lowId = std::clamp<int>((low - wfStart) * (double)dataWidth / wfWidth, 0, dataWidth - 1);
         int highId = std::clamp<int>((high - wfStart) * (double)dataWidth / wfWidth, 0, dataWidth - 1);
         
-        float max = -INFINITY;
-        for (int i = lowId; i <= highId; i++) {
-            if (data[i] > max) { max = data[i]; }
-        }
-        
-        return max;
+        return dsp::math::rangeMax(&data[lowId], highId - lowId + 1);
     }
     
     // HIGH-RESOLUTION version using raw FFT data for precise signal centering
@@ -3192,10 +3173,7 @@ private:
         int lowId = std::clamp<int>((low - wfStart) * (double)rawFFTSize / wfWidth, 0, rawFFTSize - 1);
         int highId = std::clamp<int>((high - wfStart) * (double)rawFFTSize / wfWidth, 0, rawFFTSize - 1);
         
-        float max = -INFINITY;
-        for (int i = lowId; i <= highId; i++) {
-            if (rawData[i] > max) { max = rawData[i]; }
-        }
+        float max = dsp::math::rangeMax(&rawData[lowId], highId - lowId + 1);
         
         gui::waterfall.releaseRawFFT();
         return max;
@@ -3890,11 +3868,7 @@ private:
             }
             
             // Calculate max (signal strength)
-            for (int i = vfoMinOffset; i <= vfoMaxOffset; i++) {
-                if (fftData[i] > max) { 
-                    max = fftData[i]; 
-                }
-            }
+            max = dsp::math::rangeMax(&fftData[vfoMinOffset], std::min<int>(vfoMaxOffset, fftWidth - 1) - vfoMinOffset + 1);
             
             flog::info("Scanner: Signal analysis - avgCount={}, avg={:.1f}, max={:.1f}, SNR={:.1f}", 
                       avgCount, avg, max, max - avg);
@@ -3,7 +3,7 @@
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include <signal_path/sink.h>
-#include <dsp/buffer/packer.h>
+#include <dsp/sink/fifo_sink.h>
 #include <dsp/convert/stereo_to_mono.h>
 #include <utils/flog.h>
 #include <RtAudio.h>
@@ -28,8 +28,8 @@ public:
         _stream = stream;
         _streamName = streamName;
         s2m.init(_stream->sinkOut);
-        monoPacker.init(&s2m.out, 512);
-        stereoPacker.init(_stream->sinkOut, 512);
+        monoFIFO.init(&s2m.out, 1024);
+        stereoFIFO.init(_stream->sinkOut, 1024);
 
 #if RTAUDIO_VERSION_MAJOR >= 6
         audio.setErrorCallback(&errorCallback);
@@ -194,9 +194,9 @@ private:
 
         try {
             audio.openStream(&parameters, NULL, RTAUDIO_FLOAT32, sampleRate, &bufferFrames, &callback, this, &opts);
-            stereoPacker.setSampleCount(bufferFrames);
+            stereoFIFO.setCapacity(bufferFrames * 2);
             audio.startStream();
-            stereoPacker.start();
+            stereoFIFO.start();
         }
         catch (const std::exception& e) {
             flog::error("Could not open audio device {0}", e.what());
@@ -209,30 +209,22 @@ private:
 
     void doStop() {
         s2m.stop();
-        monoPacker.stop();
-        stereoPacker.stop();
-        monoPacker.out.stopReader();
-        stereoPacker.out.stopReader();
+        monoFIFO.stop();
+        stereoFIFO.stop();
         audio.stopStream();
         audio.closeStream();
-        monoPacker.out.clearReadStop();
-        stereoPacker.out.clearReadStop();
     }
 
     static int callback(void* outputBuffer, void* inputBuffer, unsigned int nBufferFrames, double streamTime, RtAudioStreamStatus status, void* userData) {
         AudioSink* _this = (AudioSink*)userData;
-        int count = _this->stereoPacker.out.read();
-        if (count < 0) { return 0; }
-
-        memcpy(outputBuffer, _this->stereoPacker.out.readBuf, nBufferFrames * sizeof(dsp::stereo_t));
-        _this->stereoPacker.out.flush();
+        _this->stereoFIFO.fifo.tryRead((dsp::stereo_t*)outputBuffer, nBufferFrames);
         return 0;
     }
 
     SinkManager::Stream* _stream;
     dsp::convert::StereoToMono s2m;
-    dsp::buffer::Packer<float> monoPacker;
-    dsp::buffer::Packer<dsp::stereo_t> stereoPacker;
+    dsp::sink::FIFO<float> monoFIFO;
+    dsp::sink::FIFO<dsp::stereo_t> stereoFIFO;
 
     std::string _streamName;
 
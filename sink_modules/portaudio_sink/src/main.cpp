@@ -5,7 +5,7 @@
 #include <signal_path/sink.h>
 #include <portaudio.h>
 #include <dsp/convert/stereo_to_mono.h>
-#include <dsp/sink/ring_buffer.h>
+#include <dsp/sink/fifo_sink.h>
 #include <utils/flog.h>
 #include <core.h>
 
@@ -159,7 +159,7 @@ private:
         int bufferSize = sampleRate / 60.0f;
 
         if (dev->channels == 2) {
-            stereoRB.data.setMaxLatency(bufferSize * 2);
+            stereoRB.setCapacity(bufferSize * 2);
             stereoRB.start();
             // stereoPacker.setSampleCount(bufferSize);
             // stereoPacker.start();
@@ -167,7 +167,7 @@ private:
             //err = Pa_OpenStream(&stream, NULL, &outputParams, sampleRate, bufferSize, 0, _stereo_cb, this);
         }
         else {
-            monoRB.data.setMaxLatency(bufferSize * 2);
+            monoRB.setCapacity(bufferSize * 2);
             monoRB.start();
             // stereoPacker.setSampleCount(bufferSize);
             // monoPacker.start();
@@ -195,14 +195,10 @@ private:
         stereoRB.stop();
         // monoPacker.stop();
         // stereoPacker.stop();
-        monoRB.data.stopReader();
-        stereoRB.data.stopReader();
         // monoPacker.out.stopReader();
         // stereoPacker.out.stopReader();
         Pa_StopStream(stream);
         Pa_CloseStream(stream);
-        monoRB.data.clearReadStop();
-        stereoRB.data.clearReadStop();
         // monoPacker.out.clearReadStop();
         // stereoPacker.out.clearWriteStop();
     }
@@ -214,7 +210,7 @@ private:
             memset(output, 0, frameCount * sizeof(float));
             return 0;
         }
-        _this->monoRB.data.read((float*)output, frameCount);
+        _this->monoRB.fifo.tryRead((float*)output, frameCount);
         return 0;
     }
 
@@ -225,7 +221,7 @@ private:
             memset(output, 0, frameCount * sizeof(dsp::stereo_t));
             return 0;
         }
-        _this->stereoRB.data.read((dsp::stereo_t*)output, frameCount);
+        _this->stereoRB.fifo.tryRead((dsp::stereo_t*)output, frameCount);
         return 0;
     }
 
@@ -250,8 +246,8 @@ private:
 
     SinkManager::Stream* _stream;
     dsp::convert::StereoToMono s2m;
-    dsp::sink::RingBuffer<float> monoRB;
-    dsp::sink::RingBuffer<dsp::stereo_t> stereoRB;
+    dsp::sink::FIFO<float> monoRB;
+    dsp::sink::FIFO<dsp::stereo_t> stereoRB;
 
     // dsp::Packer<float> monoPacker;
     // dsp::Packer<dsp::stereo_t> stereoPacker;
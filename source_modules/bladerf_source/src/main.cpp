@@ -4,6 +4,7 @@
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <gui/style.h>
 #include <config.h>
 #include <gui/widgets/stepped_slider.h>
@@ -584,7 +585,7 @@ private:
             if (ret != 0) { break; }
 
             // Convert to complex float and swap buffers
-            volk_16i_s32f_convert_32f((float*)stream.writeBuf, buffer, 32768.0f, bufferSize * 2);
+            dsp::convert::s16ToComplex(stream.writeBuf, buffer, bufferSize);
             if (!stream.swap(bufferSize)) { break; }
         }
 
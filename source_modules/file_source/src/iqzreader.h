@@ -0,0 +1,28 @@
+#pragma once
+#include <stdexcept>
+#include <utils/iqz.h>
+#include "sample_reader.h"
+
+// Compressed IQ recording made by the recorder
+class IQZReader : public SampleReader {
+public:
+    IQZReader(std::string path) : reader(path) {
+        if (reader.getSampleRate() == 0) { throw std::runtime_error("Sample rate may not be zero"); }
+        if (reader.getChannelCount() != 2) { throw std::runtime_error("File must have two channels (I and Q)"); }
+    }
+
+    uint32_t getSampleRate() override {
+        return reader.getSampleRate();
+    }
+
+    uint64_t getFrameCount() override {
+        return reader.getFrameCount();
+    }
+
+    int read(dsp::complex_t* out, uint64_t pos, int count) override {
+        return reader.read((float*)out, pos, count);
+    }
+
+private:
+    iqz::Reader reader;
+};
@@ -5,19 +5,30 @@
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include <wavreader.h>
+#include <iqzreader.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <gui/widgets/file_select.h>
 #include <filesystem>
 #include <regex>
 #include <gui/tuner.h>
 #include <algorithm>
 #include <stdexcept>
+#include <utils/optionlist.h>
+#include <gui/style.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
 
 #define CONCAT(a, b) ((std::string(a) + b).c_str())
 
+// Maximum lag behind the playback clock before pacing gives up catching up and restarts from the current time
+#define MAX_PACING_LAG_MS   500
+
 SDRPP_MOD_INFO{
     /* Name:            */ "file_source",
-    /* Description:     */ "Wav file source module for SDR++",
+    /* Description:     */ "Wav and IQZ file source module for SDR++",
     /* Author:          */ "Ryzerth",
     /* Version:         */ 0, 1, 1,
     /* Max instances    */ 1
@@ -27,14 +38,31 @@ ConfigManager config;
 
 class FileSourceModule : public ModuleManager::Instance {
 public:
-    FileSourceModule(std::string name) : fileSelect("", { "Wav IQ Files (*.wav)", "*.wav", "All Files", "*" }) {
+    FileSourceModule(std::string name) : fileSelect("", { "IQ Files (*.wav *.iqz)", "*.wav *.iqz", "Wav IQ Files (*.wav)", "*.wav", "Compressed IQ Files (*.iqz)", "*.iqz", "All Files", "*" }) {
         this->name = name;
 
         if (core::args["server"].b()) { return; }
 
+        // Define the replay speeds, zero meaning as fast as the consumers accept the samples
+        speeds.define("1x", "1x", 1.0);
+        speeds.define("2x", "2x", 2.0);
+        speeds.define("5x", "5x", 5.0);
+        speeds.define("10x", "10x", 10.0);
+        speeds.define("20x", "20x", 20.0);
+        speeds.define("50x", "50x", 50.0);
+        speeds.define("max", "Max", 0.0);
+
         config.acquire();
         fileSelect.setPath(config.conf["path"], true);
+        if (config.conf.contains("speed")) {
+            std::string speedKey = config.conf["speed"];
+            if (speeds.keyExists(speedKey)) { speedId = speeds.keyId(speedKey); }
+        }
+        if (config.conf.contains("loop")) {
+            loop = config.conf["loop"];
+        }
         config.release();
+        speed = speeds.value(speedId);
 
         handler.ctx = this;
         handler.selectHandler = menuSelected;
@@ -93,7 +121,8 @@ private:
         if (_this->running) { return; }
         if (_this->reader == NULL) { return; }
         _this->running = true;
-        _this->workerThread = _this->float32Mode ? std::thread(floatWorker, _this) : std::thread(worker, _this);
+        _this->run = true;
+        _this->workerThread = std::thread(worker, _this);
         flog::info("FileSourceModule '{0}': Start!", _this->name);
     }
 
@@ -101,11 +130,15 @@ private:
         FileSourceModule* _this = (FileSourceModule*)ctx;
         if (!_this->running) { return; }
         if (_this->reader == NULL) { return; }
+        {
+            std::lock_guard<std::mutex> lck(_this->ctrlMtx);
+            _this->run = false;
+        }
+        _this->ctrlCnd.notify_all();
         _this->stream.stopWriter();
         _this->workerThread.join();
         _this->stream.clearWriteStop();
         _this->running = false;
-        _this->reader->rewind();
         flog::info("FileSourceModule '{0}': Stop!", _this->name);
     }
 
@@ -119,18 +152,21 @@ private:
 
         if (_this->fileSelect.render("##file_source_" + _this->name)) {
             if (_this->fileSelect.pathIsValid()) {
+                // The samples are read from the mapping, so the worker must not outlive the reader
+                bool wasRunning = _this->running;
+                if (wasRunning) { stop(_this); }
                 if (_this->reader != NULL) {
-                    _this->reader->close();
                     delete _this->reader;
+                    _this->reader = NULL;
                 }
                 try {
-                    _this->reader = new WavReader(_this->fileSelect.path);
-                    if (_this->reader->getSampleRate() == 0) {
-                        _this->reader->close();
-                        delete _this->reader;
-                        _this->reader = NULL;
-                        throw std::runtime_error("Sample rate may not be zero");
+                    if (std::filesystem::path(_this->fileSelect.path).extension() == ".iqz") {
+                        _this->reader = new IQZReader(_this->fileSelect.path);
                     }
+                    else {
+                        _this->reader = new WavReader(_this->fileSelect.path);
+                    }
+                    _this->position = 0;
                     _this->sampleRate = _this->reader->getSampleRate();
                     core::setInputSampleRate(_this->sampleRate);
                     std::string filename = std::filesystem::path(_this->fileSelect.path).filename().string();
@@ -146,39 +182,136 @@ private:
                 config.acquire();
                 config.conf["path"] = _this->fileSelect.path;
                 config.release(true);
+                if (wasRunning) { start(_this); }
             }
         }
 
-        ImGui::Checkbox("Float32 Mode##_file_source", &_this->float32Mode);
+        if (_this->reader == NULL) { return; }
+
+        ImGui::LeftLabel("Speed");
+        ImGui::FillWidth();
+        if (ImGui::Combo(CONCAT("##_file_source_speed_", _this->name), &_this->speedId, _this->speeds.txt)) {
+            _this->setSpeed(_this->speeds.value(_this->speedId));
+            config.acquire();
+            config.conf["speed"] = _this->speeds.key(_this->speedId);
+            config.release(true);
+        }
+
+        bool loop = _this->loop;
+        if (ImGui::Checkbox(CONCAT("Loop##_file_source_loop_", _this->name), &loop)) {
+            _this->setLoop(loop);
+            config.acquire();
+            config.conf["loop"] = loop;
+            config.release(true);
+        }
+
+        // Seek bar showing the current position
+        double sr = _this->reader->getSampleRate();
+        float total = (double)_this->reader->getFrameCount() / sr;
+        float pos = (double)_this->position / sr;
+        std::string posTxt = timeString(pos) + " / " + timeString(total);
+        ImGui::FillWidth();
+        if (ImGui::SliderFloat(CONCAT("##_file_source_pos_", _this->name), &pos, 0.0f, total, posTxt.c_str())) {
+            _this->seek(std::clamp<double>(pos, 0.0, total) * sr);
+        }
     }
 
-    static void worker(void* ctx) {
-        FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
-        int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        int16_t* inBuf = new int16_t[blockSize * 2];
+    static std::string timeString(double seconds) {
+        int s = seconds;
+        char buf[32];
+        sprintf(buf, "%02d:%02d:%02d", s / 3600, (s / 60) % 60, s % 60);
+        return buf;
+    }
 
-        while (true) {
-            _this->reader->readSamples(inBuf, blockSize * 2 * sizeof(int16_t));
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, inBuf, 32768.0f, blockSize * 2);
-            if (!_this->stream.swap(blockSize)) { break; };
+    void seek(uint64_t frame) {
+        {
+            std::lock_guard<std::mutex> lck(ctrlMtx);
+            seekTarget = frame;
+            seekRequested = true;
+
+            // The worker only picks up the request while running
+            if (!running) { position = frame; }
         }
+        ctrlCnd.notify_all();
+    }
 
-        delete[] inBuf;
+    void setSpeed(double speed) {
+        {
+            std::lock_guard<std::mutex> lck(ctrlMtx);
+            this->speed = speed;
+            paceReset = true;
+        }
+        ctrlCnd.notify_all();
     }
 
-    static void floatWorker(void* ctx) {
+    void setLoop(bool loop) {
+        {
+            std::lock_guard<std::mutex> lck(ctrlMtx);
+            this->loop = loop;
+        }
+        ctrlCnd.notify_all();
+    }
+
+    static void worker(void* ctx) {
         FileSourceModule* _this = (FileSourceModule*)ctx;
-        double sampleRate = std::max(_this->reader->getSampleRate(), (uint32_t)1);
+        double sampleRate = _this->reader->getSampleRate();
         int blockSize = std::min((int)(sampleRate / 200.0f), (int)STREAM_BUFFER_SIZE);
-        dsp::complex_t* inBuf = new dsp::complex_t[blockSize];
+        blockSize = std::max(blockSize, 1);
+        uint64_t frameCount = _this->reader->getFrameCount();
+        uint64_t pos = _this->position;
+
+        // The pacing clock is restarted on every seek and speed change
+        auto paceStart = std::chrono::steady_clock::now();
+        uint64_t paced = 0;
 
         while (true) {
-            _this->reader->readSamples(_this->stream.writeBuf, blockSize * sizeof(dsp::complex_t));
-            if (!_this->stream.swap(blockSize)) { break; };
-        }
+            {
+                std::unique_lock<std::mutex> lck(_this->ctrlMtx);
+                if (!_this->run) { break; }
+                if (_this->seekRequested) {
+                    pos = std::min<uint64_t>(_this->seekTarget, frameCount);
+                    _this->seekRequested = false;
+                    _this->paceReset = true;
+                }
 
-        delete[] inBuf;
+                // At the end of the file, either go back to the start or wait for a seek
+                if (pos >= frameCount) {
+                    if (!_this->loop || !frameCount) {
+                        _this->ctrlCnd.wait(lck, [=]() { return !_this->run || _this->seekRequested || _this->loop; });
+                        continue;
+                    }
+                    pos = 0;
+                }
+
+                if (_this->paceReset) {
+                    paceStart = std::chrono::steady_clock::now();
+                    paced = 0;
+                    _this->paceReset = false;
+                }
+            }
+
+            int count = _this->reader->read(_this->stream.writeBuf, pos, blockSize);
+            if (count <= 0) {
+                flog::error("FileSourceModule '{0}': Could not read samples, stopping playback", _this->name);
+                break;
+            }
+            pos += count;
+            _this->position = pos;
+            if (!_this->stream.swap(count)) { break; }
+
+            // Wait until the playback clock catches up with the samples sent so far
+            std::unique_lock<std::mutex> lck(_this->ctrlMtx);
+            if (_this->speed <= 0.0) { continue; }
+            paced += count;
+            auto deadline = paceStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((double)paced / (sampleRate * _this->speed)));
+            auto now = std::chrono::steady_clock::now();
+            if (now - deadline > std::chrono::milliseconds(MAX_PACING_LAG_MS)) {
+                // The consumers can't keep up, don't try to make up for the lost time in a burst
+                _this->paceReset = true;
+                continue;
+            }
+            _this->ctrlCnd.wait_until(lck, deadline, [=]() { return !_this->run || _this->seekRequested || _this->paceReset; });
+        }
     }
 
     double getFrequency(std::string filename) {
@@ -194,7 +327,7 @@ private:
     std::string name;
     dsp::stream<dsp::complex_t> stream;
     SourceManager::SourceHandler handler;
-    WavReader* reader = NULL;
+    SampleReader* reader = NULL;
     bool running = false;
     bool enabled = true;
     float sampleRate = 1000000;
@@ -202,12 +335,27 @@ private:
 
     double centerFreq = 100000000;
 
-    bool float32Mode = false;
+    OptionList<std::string, double> speeds;
+    int speedId = 0;
+
+    // Playback control, protected by ctrlMtx and signaled through ctrlCnd
+    std::mutex ctrlMtx;
+    std::condition_variable ctrlCnd;
+    bool run = false;
+    bool seekRequested = false;
+    uint64_t seekTarget = 0;
+    bool paceReset = false;
+    double speed = 1.0;
+    bool loop = true;
+
+    std::atomic<uint64_t> position = 0;
 };
 
 MOD_EXPORT void _INIT_() {
     json def = json({});
     def["path"] = "";
+    def["speed"] = "1x";
+    def["loop"] = true;
     config.setPath(core::args["root"].s() + "/file_source_config.json");
     config.load(def);
     config.enableAutoSave();
@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+#include <dsp/types.h>
+
+// Random access source of IQ samples for the file source
+class SampleReader {
+public:
+    virtual ~SampleReader() {}
+
+    virtual uint32_t getSampleRate() = 0;
+    virtual uint64_t getFrameCount() = 0;
+
+    // Read up to 'count' samples starting at sample 'pos'. Returns the number of samples read.
+    virtual int read(dsp::complex_t* out, uint64_t pos, int count) = 0;
+};
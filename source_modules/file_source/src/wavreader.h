@@ -1,82 +1,275 @@
-#pragma once
-
 #pragma once
 #include <stdint.h>
 #include <string.h>
-#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <volk/volk.h>
+#include <dsp/convert/iq_convert.h>
+#include "sample_reader.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
-#define WAV_SIGNATURE       "RIFF"
-#define WAV_TYPE            "WAVE"
-#define WAV_FORMAT_MARK     "fmt "
-#define WAV_DATA_MARK       "data"
-#define WAV_SAMPLE_TYPE_PCM 1
+#define WAV_SIGNATURE               "RIFF"
+#define WAV_TYPE                    "WAVE"
+#define WAV_FORMAT_MARK             "fmt "
+#define WAV_DATA_MARK               "data"
+#define WAV_SAMPLE_TYPE_PCM         1
+#define WAV_SAMPLE_TYPE_FLOAT       3
+#define WAV_SAMPLE_TYPE_EXTENSIBLE  0xFFFE
 
-class WavReader {
+// Size of the part of the file mapped at once, small enough to always find room in a 32bit address space
+#define WAV_MAP_WINDOW_SIZE         ((uint64_t)64 * 1024 * 1024)
+
+// Memory mapped wav file. The samples are accessed directly in the mapped pages and nothing is copied until they
+// are converted into the output stream. Only a window of the file is mapped at a time and moved along as it's
+// read, so files of any size can be played in 32bit builds.
+class WavReader : public SampleReader {
 public:
     WavReader(std::string path) {
-        file = std::ifstream(path.c_str(), std::ios::binary);
-        file.read((char*)&hdr, sizeof(WavHeader_t));
-        valid = false;
-        if (memcmp(hdr.signature, "RIFF", 4) != 0) { return; }
-        if (memcmp(hdr.fileType, "WAVE", 4) != 0) { return; }
-        valid = true;
+        open(path);
+        try {
+            parse();
+        }
+        catch (...) {
+            close();
+            throw;
+        }
+    }
+
+    ~WavReader() {
+        close();
     }
 
     uint16_t getBitDepth() {
-        return hdr.bitDepth;
+        return fmt.bitDepth;
     }
 
     uint16_t getChannelCount() {
-        return hdr.channelCount;
+        return fmt.channelCount;
+    }
+
+    uint32_t getSampleRate() override {
+        return fmt.sampleRate;
     }
 
-    uint32_t getSampleRate() {
-        return hdr.sampleRate;
+    bool isFloat() {
+        return sampleType == WAV_SAMPLE_TYPE_FLOAT;
     }
 
-    bool isValid() {
-        return valid;
+    // Size of a frame, that is one sample of each channel, in bytes
+    int getFrameSize() {
+        return frameSize;
     }
 
-    void readSamples(void* data, size_t size) {
-        char* _data = (char*)data;
-        file.read(_data, size);
-        int read = file.gcount();
-        if (read < size) {
-            file.clear();
-            file.seekg(sizeof(WavHeader_t));
-            file.read(&_data[read], size - read);
+    uint64_t getFrameCount() override {
+        return frameCount;
+    }
+
+    // Convert frames straight from the mapped file to complex samples
+    int read(dsp::complex_t* out, uint64_t pos, int count) override {
+        if (pos >= frameCount) { return 0; }
+        count = std::min<uint64_t>(count, frameCount - pos);
+        const uint8_t* in = getFrames(pos, count);
+        if (!in) { return -1; }
+        if (isFloat()) {
+            memcpy(out, in, count * sizeof(dsp::complex_t));
+            return count;
+        }
+        switch (fmt.bitDepth) {
+        case 8:
+            dsp::convert::u8ToComplex(out, in, count, 128.0f);
+            break;
+        case 16:
+            dsp::convert::s16ToComplex(out, (const int16_t*)in, count);
+            break;
+        case 32:
+            volk_32i_s32f_convert_32f((float*)out, (const int32_t*)in, 2147483648.0f, count * 2);
+            break;
         }
-        bytesRead += size;
+        return count;
     }
 
-    void rewind() {
-        file.seekg(sizeof(WavHeader_t));
+    // Pointer to 'count' frames starting at index 'pos', valid until the next call. Returns NULL if they can't be mapped.
+    const uint8_t* getFrames(uint64_t pos, int count) {
+        return view(dataOffset + pos * frameSize, (size_t)count * frameSize);
     }
 
     void close() {
-        file.close();
+        unmap();
+#ifdef _WIN32
+        if (mapping) { CloseHandle(mapping); }
+        if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) { ::close(fd); }
+        fd = -1;
+#endif
     }
 
 private:
-    struct WavHeader_t {
-        char signature[4];           // "RIFF"
-        uint32_t fileSize;           // data bytes + sizeof(WavHeader_t) - 8
-        char fileType[4];            // "WAVE"
-        char formatMarker[4];        // "fmt "
-        uint32_t formatHeaderLength; // Always 16
-        uint16_t sampleType;         // PCM (1)
+    void open(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) { throw std::runtime_error("Could not open file"); }
+        LARGE_INTEGER fsize;
+        if (!GetFileSizeEx(file, &fsize) || !fsize.QuadPart) {
+            close();
+            throw std::runtime_error("Could not get file size or file empty");
+        }
+        size = fsize.QuadPart;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) {
+            close();
+            throw std::runtime_error("Could not map file");
+        }
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        granularity = info.dwAllocationGranularity;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::runtime_error("Could not open file"); }
+        struct stat st;
+        if (fstat(fd, &st) || !st.st_size) {
+            close();
+            throw std::runtime_error("Could not get file size or file empty");
+        }
+        size = st.st_size;
+        granularity = sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    // Pointer to 'len' bytes of the file at 'offset', moving the mapped window if they're not in it
+    const uint8_t* view(uint64_t offset, size_t len) {
+        if (offset + len > size) { return NULL; }
+        if (base && offset >= winStart && offset + len <= winStart + winSize) {
+            return &base[offset - winStart];
+        }
+
+        // Map a window starting at the requested offset, rounded down to what the OS accepts as a mapping offset
+        unmap();
+        uint64_t start = offset - (offset % granularity);
+        uint64_t winLen = std::min<uint64_t>(std::max<uint64_t>(WAV_MAP_WINDOW_SIZE, offset + len - start), size - start);
+#ifdef _WIN32
+        void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, (SIZE_T)winLen);
+        if (!ptr) { return NULL; }
+#else
+        void* ptr = mmap(NULL, winLen, PROT_READ, MAP_SHARED, fd, (off_t)start);
+        if (ptr == MAP_FAILED) { return NULL; }
+
+        // Playback is mostly sequential, let the kernel read ahead aggressively
+        madvise(ptr, winLen, MADV_SEQUENTIAL);
+#endif
+        base = (const uint8_t*)ptr;
+        winStart = start;
+        winSize = winLen;
+        return &base[offset - winStart];
+    }
+
+    void unmap() {
+        if (!base) { return; }
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+#else
+        munmap((void*)base, winSize);
+#endif
+        base = NULL;
+    }
+
+    void parse() {
+        const uint8_t* riff = view(0, 12);
+        if (!riff || memcmp(riff, WAV_SIGNATURE, 4) || memcmp(&riff[8], WAV_TYPE, 4)) {
+            throw std::runtime_error("Not a wav file");
+        }
+
+        // Walk the chunks to find the format and the data
+        bool fmtFound = false;
+        uint64_t offset = 12;
+        while (offset + 8 <= size) {
+            // Copied out since reading the chunk can move the mapped window
+            const uint8_t* chunk = view(offset, 8);
+            if (!chunk) { throw std::runtime_error("Could not map file"); }
+            char id[4];
+            uint32_t len;
+            memcpy(id, chunk, 4);
+            memcpy(&len, &chunk[4], sizeof(uint32_t));
+            offset += 8;
+
+            if (!memcmp(id, WAV_FORMAT_MARK, 4)) {
+                const uint8_t* data = (len >= sizeof(FormatHeader)) ? view(offset, std::min<uint32_t>(len, 26)) : NULL;
+                if (!data) { throw std::runtime_error("Invalid format chunk"); }
+                memcpy(&fmt, data, sizeof(FormatHeader));
+                sampleType = fmt.sampleType;
+
+                // The extensible format gives the actual type in the first two bytes of the sub-format GUID
+                if (sampleType == WAV_SAMPLE_TYPE_EXTENSIBLE && len >= 26) {
+                    memcpy(&sampleType, &data[24], sizeof(uint16_t));
+                }
+                fmtFound = true;
+            }
+            else if (!memcmp(id, WAV_DATA_MARK, 4)) {
+                if (!fmtFound) { throw std::runtime_error("Data chunk before format chunk"); }
+                dataOffset = offset;
+
+                // Files whose recording didn't finish properly can have a wrong data size, trust the file size instead
+                uint64_t dataSize = std::min<uint64_t>(len, size - offset);
+                if (!len) { dataSize = size - offset; }
+                frameSize = fmt.channelCount * (fmt.bitDepth / 8);
+                if (!frameSize) { throw std::runtime_error("Invalid frame size"); }
+                frameCount = dataSize / frameSize;
+                checkFormat();
+                return;
+            }
+
+            // Chunks are padded to an even size
+            offset += len + (len & 1);
+        }
+
+        throw std::runtime_error("No data chunk found");
+    }
+
+    void checkFormat() {
+        if (fmt.sampleRate == 0) { throw std::runtime_error("Sample rate may not be zero"); }
+        if (fmt.channelCount != 2) { throw std::runtime_error("File must have two channels (I and Q)"); }
+        int depth = fmt.bitDepth;
+        if (isFloat() ? depth != 32 : (depth != 8 && depth != 16 && depth != 32)) { throw std::runtime_error("Unsupported sample format"); }
+    }
+
+    struct FormatHeader {
+        uint16_t sampleType;
         uint16_t channelCount;
         uint32_t sampleRate;
         uint32_t bytesPerSecond;
         uint16_t bytesPerSample;
         uint16_t bitDepth;
-        char dataMarker[4]; // "data"
-        uint32_t dataSize;
     };
 
-    bool valid = false;
-    std::ifstream file;
-    size_t bytesRead = 0;
-    WavHeader_t hdr;
-};
\ No newline at end of file
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+    uint64_t size = 0;
+    uint64_t granularity = 4096;
+
+    // Currently mapped part of the file
+    const uint8_t* base = NULL;
+    uint64_t winStart = 0;
+    uint64_t winSize = 0;
+
+    FormatHeader fmt;
+    uint16_t sampleType = 0;
+    uint64_t dataOffset = 0;
+    int frameSize = 0;
+    uint64_t frameCount = 0;
+};
@@ -3,6 +3,7 @@
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <gui/style.h>
 #include <config.h>
 #include <gui/widgets/stepped_slider.h>
@@ -384,7 +385,7 @@ private:
 
     static int callback(hackrf_transfer* transfer) {
         HackRFSourceModule* _this = (HackRFSourceModule*)transfer->rx_ctx;
-        volk_8i_s32f_convert_32f((float*)_this->stream.writeBuf, (int8_t*)transfer->buffer, 128.0f, transfer->valid_length);
+        dsp::convert::s8ToComplex(_this->stream.writeBuf, (int8_t*)transfer->buffer, transfer->valid_length / 2);
         if (!_this->stream.swap(transfer->valid_length / 2)) { return -1; }
         return 0;
     }
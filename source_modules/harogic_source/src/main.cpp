@@ -4,6 +4,7 @@
 #include <gui/smgui.h>
 #include <signal_path/signal_path.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <utils/optionlist.h>
 #include <htra_api.h>
 #include <atomic>
@@ -407,8 +408,6 @@ private:
     }
 
     void worker() {
-        // Allocate sample buffer
-        int realSamps = bufferSize*2;
         IQStream_TypeDef iqs;
 
         // Define number of buffers per swap to maintain 200 fps
@@ -442,10 +441,10 @@ private:
 
             // Convert them to floating point
             if (sampsInt8) {
-                volk_8i_s32f_convert_32f((float*)&stream.writeBuf[(count++)*bufferSize], (int8_t*)iqs.AlternIQStream, 128.0f, realSamps);
+                dsp::convert::s8ToComplex(&stream.writeBuf[(count++)*bufferSize], (int8_t*)iqs.AlternIQStream, bufferSize);
             }
             else {
-                volk_16i_s32f_convert_32f((float*)&stream.writeBuf[(count++)*bufferSize], (int16_t*)iqs.AlternIQStream, 32768.0f, realSamps);
+                dsp::convert::s16ToComplex(&stream.writeBuf[(count++)*bufferSize], (int16_t*)iqs.AlternIQStream, bufferSize);
             }
 
             // Send them off if we have enough
@@ -4,6 +4,7 @@
 #include <gui/smgui.h>
 #include <signal_path/signal_path.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <utils/optionlist.h>
 #include "kcsdr.h"
 #include <atomic>
@@ -273,7 +274,7 @@ private:
             }
 
             // Convert the samples to float
-            volk_16i_s32f_convert_32f((float*)stream.writeBuf, samps, 8192.0f, count*2);
+            dsp::convert::s16ToComplex(stream.writeBuf, samps, count, 0.0f, 1.0f / 8192.0f);
 
             // Send out the samples
             if (!stream.swap(count)) { break; }
@@ -4,6 +4,7 @@
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <gui/style.h>
 #include <config.h>
 #include <gui/smgui.h>
@@ -295,10 +296,10 @@ private:
             int count = bytes / sampleSize;
             switch (sampType) {
             case SAMPLE_TYPE_INT8:
-                volk_8i_s32f_convert_32f((float*)stream.writeBuf, (int8_t*)buffer, 128.0f, count*2);
+                dsp::convert::s8ToComplex(stream.writeBuf, (int8_t*)buffer, count);
                 break;
             case SAMPLE_TYPE_INT16:
-                volk_16i_s32f_convert_32f((float*)stream.writeBuf, (int16_t*)buffer, 32768.0f, count*2);
+                dsp::convert::s16ToComplex(stream.writeBuf, (int16_t*)buffer, count);
                 break;
             case SAMPLE_TYPE_INT32:
                 volk_32i_s32f_convert_32f((float*)stream.writeBuf, (int32_t*)buffer, 2147483647.0f, count*2);
@@ -3,6 +3,7 @@
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <gui/style.h>
 #include <gui/smgui.h>
 #include <iio.h>
@@ -518,7 +519,7 @@ private:
             if (!buf) { break; }
 
             // Convert samples to CF32
-            volk_16i_s32f_convert_32f((float*)_this->stream.writeBuf, buf, 32768.0f, blockSize * 2);
+            dsp::convert::s16ToComplex(_this->stream.writeBuf, buf, blockSize);
 
             // Send out the samples
             if (!_this->stream.swap(blockSize)) { break; };
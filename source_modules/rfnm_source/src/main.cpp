@@ -5,6 +5,7 @@
 #include <signal_path/signal_path.h>
 #include <librfnm/librfnm.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <utils/optionlist.h>
 #include <atomic>
 
@@ -446,7 +447,7 @@ private:
             else if (fail) { break; }
 
             // Convert buffer to CF32
-            volk_16i_s32f_convert_32f((float*)&stream.writeBuf[(count++)*sampCount], (int16_t*)lrxbuf->buf, 32768.0f, sampCount * 2);
+            dsp::convert::s16ToComplex(&stream.writeBuf[(count++)*sampCount], (int16_t*)lrxbuf->buf, sampCount);
 
             // Reque buffer
             openDev->rx_qbuf(lrxbuf);
@@ -3,6 +3,7 @@
 #include <gui/gui.h>
 #include <signal_path/signal_path.h>
 #include <core.h>
+#include <dsp/convert/iq_convert.h>
 #include <gui/style.h>
 #include <config.h>
 #include <gui/smgui.h>
@@ -590,10 +591,7 @@ private:
     static void asyncHandler(unsigned char* buf, uint32_t len, void* ctx) {
         RTLSDRSourceModule* _this = (RTLSDRSourceModule*)ctx;
         int sampCount = len / 2;
-        for (int i = 0; i < sampCount; i++) {
-            _this->stream.writeBuf[i].re = ((float)buf[i * 2] - 127.4) / 128.0f;
-            _this->stream.writeBuf[i].im = ((float)buf[(i * 2) + 1] - 127.4) / 128.0f;
-        }
+        dsp::convert::u8ToComplex(_this->stream.writeBuf, buf, sampCount, 127.4f);
         if (!_this->stream.swap(sampCount)) { return; }
     }
 
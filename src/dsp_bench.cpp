@@ -0,0 +1,342 @@
+#include <dsp/bench/speed_tester.h>
+#include <dsp/bench/max_pool_speed.h>
+#include <dsp/bench/quadrature_speed.h>
+#include <dsp/bench/iq_convert_speed.h>
+#include <dsp/filter/fir.h>
+#include <dsp/filter/decimating_fir.h>
+#include <dsp/filter/overlap_save_fir.h>
+#include <dsp/filter/half_band_decimator.h>
+#include <dsp/multirate/power_decimator.h>
+#include <dsp/multirate/rational_resampler.h>
+#include <dsp/channel/rx_vfo.h>
+#include <dsp/channel/xlating_decimator.h>
+#include <dsp/correction/dc_blocker.h>
+#include <dsp/demod/quadrature.h>
+#include <dsp/demod/fm.h>
+#include <dsp/demod/am.h>
+#include <dsp/demod/ssb.h>
+#include <dsp/demod/broadcast_fm.h>
+#include <dsp/loop/agc.h>
+#include <dsp/loop/fast_agc.h>
+#include <dsp/clock_recovery/mm.h>
+#include <dsp/clock_recovery/fd.h>
+#include <dsp/buffer/reshaper.h>
+#include <dsp/taps/half_band.h>
+#include <dsp/window/nuttall.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Standalone benchmark of the DSP blocks of the core, see printUsage() for the options.
+// Results are written as CSV (or JSON lines) so that runs can be compared by scripts. Some blocks
+// print diagnostics to stdout when they're configured, use -o to get the results on their own.
+
+// A benchmark case returns its throughput in input samples (or bins) per second
+struct BenchCase {
+    std::string name;
+    std::string params;
+    std::function<double(int durationMs, int chunkSize)> run;
+};
+
+// Run a block started on 'in' through a SpeedTester and stop it again
+template <class I, class O, class B>
+double blockSpeed(B& block, dsp::stream<I>& in, int durationMs, int chunkSize) {
+    dsp::bench::SpeedTester<I, O> tester(&in, &block.out);
+    block.start();
+    double speed = tester.benchmark(durationMs, chunkSize);
+    block.stop();
+    return speed;
+}
+
+static dsp::tap<float> benchTaps(int count) {
+    return dsp::taps::windowedSinc<float>(count, 0.25 * DB_M_PI, dsp::window::nuttall);
+}
+
+static std::vector<BenchCase> buildCases() {
+    std::vector<BenchCase> cases;
+
+    // Filters
+    for (int count : { 15, 63, 255, 1023 }) {
+        cases.push_back({ "filter::FIR", "taps=" + std::to_string(count), [count](int ms, int chunk) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::tap<float> taps = benchTaps(count);
+            dsp::filter::FIR<dsp::complex_t, float> fir(&in, taps);
+            double speed = blockSpeed<dsp::complex_t, dsp::complex_t>(fir, in, ms, chunk);
+            dsp::taps::free(taps);
+            return speed;
+        } });
+    }
+    for (int count : { 255, 1023, 4095 }) {
+        cases.push_back({ "filter::OverlapSaveFIR", "taps=" + std::to_string(count), [count](int ms, int chunk) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::tap<float> taps = benchTaps(count);
+            dsp::filter::OverlapSaveFIR<dsp::complex_t, float> fir(&in, taps);
+            double speed = blockSpeed<dsp::complex_t, dsp::complex_t>(fir, in, ms, chunk);
+            dsp::taps::free(taps);
+            return speed;
+        } });
+    }
+    for (int decim : { 2, 4, 16 }) {
+        cases.push_back({ "filter::DecimatingFIR", "taps=63 decim=" + std::to_string(decim), [decim](int ms, int chunk) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::tap<float> taps = benchTaps(63);
+            dsp::filter::DecimatingFIR<dsp::complex_t, float> fir(&in, taps, decim);
+            double speed = blockSpeed<dsp::complex_t, dsp::complex_t>(fir, in, ms, chunk);
+            dsp::taps::free(taps);
+            return speed;
+        } });
+    }
+    for (double transWidth : { 0.1, 0.02 }) {
+        dsp::tap<float> probe = dsp::taps::halfBand(transWidth, 1.0);
+        std::string params = "taps=" + std::to_string(probe.size);
+        dsp::taps::free(probe);
+        cases.push_back({ "filter::HalfBandDecimator", params, [transWidth](int ms, int chunk) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::tap<float> taps = dsp::taps::halfBand(transWidth, 1.0);
+            dsp::filter::HalfBandDecimator<dsp::complex_t> hb(&in, taps);
+            double speed = blockSpeed<dsp::complex_t, dsp::complex_t>(hb, in, ms, chunk);
+            dsp::taps::free(taps);
+            return speed;
+        } });
+    }
+
+    // Resamplers
+    for (int ratio : { 2, 4, 8, 16, 32, 64, 128, 256 }) {
+        cases.push_back({ "multirate::PowerDecimator", "ratio=" + std::to_string(ratio), [ratio](int ms, int chunk) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::multirate::PowerDecimator<dsp::complex_t> decim(&in, ratio);
+            return blockSpeed<dsp::complex_t, dsp::complex_t>(decim, in, ms, chunk);
+        } });
+    }
+    const std::vector<std::pair<double, double>> ratePairs = {
+        { 2.4e6, 48e3 }, { 250e3, 48e3 }, { 48e3, 44.1e3 }, { 44.1e3, 48e3 }, { 192e3, 48e3 }, { 10e6, 12.5e3 }, { 1e6, 48e3 * 1.0001 }
+    };
+    for (auto [inSr, outSr] : ratePairs) {
+        char params[64];
+        snprintf(params, sizeof(params), "in=%.0f out=%.1f", inSr, outSr);
+        cases.push_back({ "multirate::RationalResampler", params, [inSr, outSr](int ms, int chunk) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::multirate::RationalResampler<dsp::complex_t> resamp(&in, inSr, outSr);
+            return blockSpeed<dsp::complex_t, dsp::complex_t>(resamp, in, ms, chunk);
+        } });
+    }
+
+    // Channelization
+    const std::vector<std::pair<double, double>> vfoRates = { { 2.4e6, 48e3 }, { 10e6, 200e3 }, { 20e6, 12.5e3 } };
+    for (auto [inSr, outSr] : vfoRates) {
+        char params[64];
+        snprintf(params, sizeof(params), "in=%.0f out=%.0f", inSr, outSr);
+        cases.push_back({ "channel::RxVFO", params, [inSr, outSr](int ms, int chunk) {
+            dsp::stream<dsp::complex_t> in;
+            dsp::channel::RxVFO vfo(&in, inSr, outSr, outSr * 0.8, inSr / 7.0);
+            return blockSpeed<dsp::complex_t, dsp::complex_t>(vfo, in, ms, chunk);
+        } });
+    }
+    cases.push_back({ "channel::XlatingDecimator", "taps=63 decim=8", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::tap<float> taps = benchTaps(63);
+        dsp::channel::XlatingDecimator xdecim(&in, 100e3, 2.4e6, taps, 8);
+        double speed = blockSpeed<dsp::complex_t, dsp::complex_t>(xdecim, in, ms, chunk);
+        dsp::taps::free(taps);
+        return speed;
+    } });
+    cases.push_back({ "correction::DCBlocker", "", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::correction::DCBlocker<dsp::complex_t> dcb(&in, 50.0 / 2.4e6);
+        return blockSpeed<dsp::complex_t, dsp::complex_t>(dcb, in, ms, chunk);
+    } });
+
+    // Demodulators
+    cases.push_back({ "demod::Quadrature", "", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::Quadrature demod(&in, 5e3, 50e3);
+        return blockSpeed<dsp::complex_t, float>(demod, in, ms, chunk);
+    } });
+    cases.push_back({ "demod::FM", "sr=50000 bw=12500", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::FM<dsp::stereo_t> demod;
+        demod.init(&in, 50e3, 12.5e3, true, false);
+        return blockSpeed<dsp::complex_t, dsp::stereo_t>(demod, in, ms, chunk);
+    } });
+    cases.push_back({ "demod::BroadcastFM", "sr=250000 stereo", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::BroadcastFM demod(&in, 75e3, 250e3, true, true);
+        return blockSpeed<dsp::complex_t, dsp::stereo_t>(demod, in, ms, chunk);
+    } });
+    cases.push_back({ "demod::AM", "sr=15000 carrier agc", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::AM<dsp::stereo_t> demod(&in, dsp::demod::AM<dsp::stereo_t>::AGCMode::CARRIER, 10e3, 50.0 / 15e3, 5.0 / 15e3, 100.0 / 15e3, 15e3);
+        return blockSpeed<dsp::complex_t, dsp::stereo_t>(demod, in, ms, chunk);
+    } });
+    cases.push_back({ "demod::SSB", "sr=24000 usb", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::demod::SSB<dsp::stereo_t> demod(&in, dsp::demod::SSB<dsp::stereo_t>::Mode::USB, 2.8e3, 24e3, 50.0 / 24e3, 5.0 / 24e3);
+        return blockSpeed<dsp::complex_t, dsp::stereo_t>(demod, in, ms, chunk);
+    } });
+
+    // Loops
+    cases.push_back({ "loop::AGC", "float", [](int ms, int chunk) {
+        dsp::stream<float> in;
+        dsp::loop::AGC<float> agc(&in, 1.0, 50.0 / 48e3, 5.0 / 48e3, 10e6, 10.0);
+        return blockSpeed<float, float>(agc, in, ms, chunk);
+    } });
+    cases.push_back({ "loop::AGC", "complex", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::loop::AGC<dsp::complex_t> agc(&in, 1.0, 50.0 / 48e3, 5.0 / 48e3, 10e6, 10.0);
+        return blockSpeed<dsp::complex_t, dsp::complex_t>(agc, in, ms, chunk);
+    } });
+    cases.push_back({ "loop::FastAGC", "complex", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::loop::FastAGC<dsp::complex_t> agc(&in, 1.0, 10e6, 1e-3);
+        return blockSpeed<dsp::complex_t, dsp::complex_t>(agc, in, ms, chunk);
+    } });
+
+    // Clock recovery
+    cases.push_back({ "clock_recovery::MM", "complex omega=10", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::clock_recovery::MM<dsp::complex_t> mm(&in, 10.0, 1e-6, 0.01, 0.01);
+        return blockSpeed<dsp::complex_t, dsp::complex_t>(mm, in, ms, chunk);
+    } });
+    cases.push_back({ "clock_recovery::FD", "omega=10", [](int ms, int chunk) {
+        dsp::stream<float> in;
+        dsp::clock_recovery::FD fd(&in, 10.0, 1e-6, 0.01, 0.01);
+        return blockSpeed<float, float>(fd, in, ms, chunk);
+    } });
+
+    // Buffers
+    cases.push_back({ "buffer::Reshaper", "keep=8192 skip=8192", [](int ms, int chunk) {
+        dsp::stream<dsp::complex_t> in;
+        dsp::buffer::Reshaper<dsp::complex_t> reshaper(&in, 8192, 8192);
+        return blockSpeed<dsp::complex_t, dsp::complex_t>(reshaper, in, ms, chunk);
+    } });
+
+    // Functions without a block
+    cases.push_back({ "math::maxPool", "in=65536 out=1024", [](int ms, int chunk) {
+        return dsp::bench::maxPoolSpeed(65536, 1024, ms);
+    } });
+    cases.push_back({ "bench::quadratureReference", "", [](int ms, int chunk) {
+        return dsp::bench::quadratureReferenceSpeed(ms);
+    } });
+    const std::vector<std::pair<dsp::math::Atan2Accuracy, const char*>> accuracies = {
+        { dsp::math::ATAN2_ACCURACY_LOW, "accuracy=low" },
+        { dsp::math::ATAN2_ACCURACY_MEDIUM, "accuracy=medium" },
+        { dsp::math::ATAN2_ACCURACY_HIGH, "accuracy=high" }
+    };
+    for (auto [acc, params] : accuracies) {
+        cases.push_back({ "demod::Quadrature::process", params, [acc = acc](int ms, int chunk) {
+            return dsp::bench::quadratureSpeed(acc, ms);
+        } });
+    }
+
+
+    // IQ conversion of the source modules
+    cases.push_back({ "convert::u8ToComplex", "reference", [](int ms, int chunk) {
+        return dsp::bench::iqConvertSpeed(dsp::bench::u8ToComplexReference, 2, ms);
+    } });
+    cases.push_back({ "convert::u8ToComplex", "", [](int ms, int chunk) {
+        return dsp::bench::iqConvertSpeed([](dsp::complex_t* out, const uint8_t* in, int count) { dsp::convert::u8ToComplex(out, in, count, 127.4f); }, 2, ms);
+    } });
+    cases.push_back({ "convert::u8ToComplex", "swap", [](int ms, int chunk) {
+        return dsp::bench::iqConvertSpeed([](dsp::complex_t* out, const uint8_t* in, int count) { dsp::convert::u8ToComplex(out, in, count, 127.4f, 1.0f / 128.0f, true); }, 2, ms);
+    } });
+    cases.push_back({ "convert::s8ToComplex", "", [](int ms, int chunk) {
+        return dsp::bench::iqConvertSpeed([](dsp::complex_t* out, const uint8_t* in, int count) { dsp::convert::s8ToComplex(out, (const int8_t*)in, count); }, 2, ms);
+    } });
+    cases.push_back({ "convert::s16ToComplex", "", [](int ms, int chunk) {
+        return dsp::bench::iqConvertSpeed([](dsp::complex_t* out, const uint8_t* in, int count) { dsp::convert::s16ToComplex(out, (const int16_t*)in, count); }, 4, ms);
+    } });
+    cases.push_back({ "convert::s16ToComplex", "offset", [](int ms, int chunk) {
+        return dsp::bench::iqConvertSpeed([](dsp::complex_t* out, const uint8_t* in, int count) { dsp::convert::s16ToComplex(out, (const int16_t*)in, count, 0.5f); }, 4, ms);
+    } });
+    cases.push_back({ "convert::s12PackedToComplex", "", [](int ms, int chunk) {
+        return dsp::bench::iqConvertSpeed([](dsp::complex_t* out, const uint8_t* in, int count) { dsp::convert::s12PackedToComplex(out, in, count); }, 3, ms);
+    } });
+
+    return cases;
+}
+
+static void printUsage(const char* name) {
+    fprintf(stderr, "Usage: %s [options]\n", name);
+    fprintf(stderr, "  -d, --duration <ms>   Duration of each benchmark (default: 1000)\n");
+    fprintf(stderr, "  -c, --chunk <count>   Samples written to the block per chunk (default: 16384)\n");
+    fprintf(stderr, "  -f, --filter <text>   Only run the benchmarks whose name contains <text>\n");
+    fprintf(stderr, "  -j, --json            Output JSON lines instead of CSV\n");
+    fprintf(stderr, "  -o, --output <file>   Write the results to <file> instead of stdout\n");
+    fprintf(stderr, "  -l, --list            List the benchmarks without running them\n");
+    fprintf(stderr, "  -h, --help            Show this help\n");
+}
+
+int main(int argc, char* argv[]) {
+    int durationMs = 1000;
+    int chunkSize = 16384;
+    std::string filter = "";
+    std::string outPath = "";
+    bool json = false;
+    bool list = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        if ((arg == "-d" || arg == "--duration") && hasValue) {
+            durationMs = std::max<int>(atoi(argv[++i]), 1);
+        }
+        else if ((arg == "-c" || arg == "--chunk") && hasValue) {
+            chunkSize = std::clamp<int>(atoi(argv[++i]), 1, STREAM_BUFFER_SIZE);
+        }
+        else if ((arg == "-f" || arg == "--filter") && hasValue) {
+            filter = argv[++i];
+        }
+        else if ((arg == "-o" || arg == "--output") && hasValue) {
+            outPath = argv[++i];
+        }
+        else if (arg == "-j" || arg == "--json") {
+            json = true;
+        }
+        else if (arg == "-l" || arg == "--list") {
+            list = true;
+        }
+        else {
+            printUsage(argv[0]);
+            return (arg == "-h" || arg == "--help") ? 0 : -1;
+        }
+    }
+
+    FILE* out = stdout;
+    if (!outPath.empty()) {
+        out = fopen(outPath.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Could not open %s\n", outPath.c_str());
+            return -1;
+        }
+    }
+
+    // Fixed seed so that every run processes the same signals
+    srand(0);
+
+    if (!json && !list) {
+        fprintf(out, "name,params,msps,ns_per_sample\n");
+    }
+    for (auto& bc : buildCases()) {
+        if (!filter.empty() && bc.name.find(filter) == std::string::npos) { continue; }
+        if (list) {
+            fprintf(out, "%s %s\n", bc.name.c_str(), bc.params.c_str());
+            continue;
+        }
+
+        double speed = bc.run(durationMs, chunkSize);
+        double msps = speed / 1e6;
+        double nsPerSample = (speed > 0.0) ? (1e9 / speed) : 0.0;
+        if (json) {
+            fprintf(out, "{\"name\":\"%s\",\"params\":\"%s\",\"msps\":%.3f,\"ns_per_sample\":%.3f}\n", bc.name.c_str(), bc.params.c_str(), msps, nsPerSample);
+        }
+        else {
+            fprintf(out, "%s,%s,%.3f,%.3f\n", bc.name.c_str(), bc.params.c_str(), msps, nsPerSample);
+        }
+        fflush(out);
+    }
+
+    if (out != stdout) { fclose(out); }
+    return 0;
+}